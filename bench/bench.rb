@@ -0,0 +1,91 @@
+# frozen_string_literal: true
+
+# Throughput of the tokenizer and parser over the generated corpus.
+#
+#   ruby -Ilib bench/bench.rb [iterations] [size_in_bytes]
+#
+# Each case reports the best of `iterations` runs.
+
+require 'html_tokenizer'
+require_relative 'corpus'
+
+module HtmlTokenizerBench
+  CASES = {
+    "Tokenizer#tokenize" => lambda do |parts|
+      count = 0
+      tokenizer = HtmlTokenizer::Tokenizer.new
+      parts.each { |kind, part| tokenizer.tokenize(part) { count += 1 } if kind == :html }
+      count
+    end,
+    "Tokenizer#tokenize_to_buffer" => lambda do |parts|
+      tokenizer = HtmlTokenizer::Tokenizer.new
+      parts.sum { |kind, part| kind == :html ? tokenizer.tokenize_to_buffer(part).size : 0 }
+    end,
+    "Parser#parse" => lambda do |parts|
+      count = 0
+      parser = HtmlTokenizer::Parser.new
+      parts.each do |kind, part|
+        if kind == :html
+          parser.parse(part) { count += 1 }
+        else
+          parser.append_placeholder(part)
+        end
+      end
+      count
+    end,
+    "Parser#parse_events" => lambda do |parts|
+      count = 0
+      parser = HtmlTokenizer::Parser.new
+      parts.each do |kind, part|
+        if kind == :html
+          parser.parse_events(part) { count += 1 }
+        else
+          parser.append_placeholder(part)
+        end
+      end
+      count
+    end,
+    "Parser#parse_tokens" => lambda do |parts|
+      parser = HtmlTokenizer::Parser.new
+      parts.sum do |kind, part|
+        if kind == :html
+          parser.parse_tokens(part).size
+        else
+          parser.append_placeholder(part)
+          0
+        end
+      end
+    end,
+  }.freeze
+
+  def self.measure(parts, iterations, &block)
+    best = nil
+    tokens = allocations = 0
+    iterations.times do
+      GC.start
+      allocated = GC.stat(:total_allocated_objects)
+      start = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+      tokens = block.call(parts)
+      elapsed = Process.clock_gettime(Process::CLOCK_MONOTONIC) - start
+      allocations = GC.stat(:total_allocated_objects) - allocated
+      best = elapsed if best.nil? || elapsed < best
+    end
+    [best, tokens, allocations]
+  end
+
+  def self.run(iterations, size)
+    puts format("%-22s %-30s %10s %12s %12s", "document", "case", "MB/s", "tokens/s", "allocs/token")
+    Corpus.documents(size: size).each do |name, parts|
+      bytes = parts.sum { |_, part| part.bytesize }
+      CASES.each do |label, block|
+        elapsed, tokens, allocations = measure(parts, iterations, &block)
+        puts format("%-22s %-30s %10.1f %12.0f %12.3f", name, label,
+          bytes / elapsed / 1_000_000.0, tokens / elapsed, allocations.fdiv([tokens, 1].max))
+      end
+    end
+  end
+end
+
+if $PROGRAM_NAME == __FILE__
+  HtmlTokenizerBench.run(Integer(ARGV[0] || 5), Integer(ARGV[1] || (1 << 20)))
+end
@@ -0,0 +1,90 @@
+/*
+  Times tokenizer_scan_all over a file with a counting callback, so the
+  scan loop can be profiled without the Ruby method and block overhead:
+
+    make -C bench/c
+    perf record bench/c/scan_bench tmp/bench/text_heavy.html 50
+
+  Links only the core library, input is scanned as utf-8.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "hooks.h"
+#include "tokenizer.h"
+
+static void count_token(struct tokenizer_t *tk, enum token_type type, long unsigned int length, long unsigned int mb_length, void *data)
+{
+  (*(long unsigned int *)data)++;
+}
+
+static char *read_file(const char *path, long unsigned int *length)
+{
+  FILE *file = fopen(path, "rb");
+  char *data;
+  long size;
+
+  if(!file)
+    return NULL;
+  fseek(file, 0, SEEK_END);
+  size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  data = malloc(size + 1);
+  if(data && fread(data, 1, size, file) != (size_t)size) {
+    free(data);
+    data = NULL;
+  }
+  fclose(file);
+  if(data)
+    data[size] = 0;
+  *length = size;
+  return data;
+}
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+  static struct tokenizer_t tk;
+  long unsigned int length = 0, tokens = 0;
+  int i, iterations;
+  double start, elapsed, best = 0;
+  char *data;
+
+  if(argc < 2) {
+    fprintf(stderr, "usage: %s file.html [iterations]\n", argv[0]);
+    return 1;
+  }
+  iterations = argc > 2 ? atoi(argv[2]) : 20;
+  if(!(data = read_file(argv[1], &length))) {
+    perror(argv[1]);
+    return 1;
+  }
+
+  ht_init(NULL);
+
+  for(i = 0; i < iterations; i++) {
+    tokens = 0;
+    tokenizer_init(&tk);
+    tk.f_callback = count_token;
+    tk.callback_data = &tokens;
+    tokenizer_borrow_scan_string(&tk, data, length);
+
+    start = now();
+    tokenizer_scan_all(&tk);
+    elapsed = now() - start;
+
+    tokenizer_free_members(&tk);
+    if(i == 0 || elapsed < best)
+      best = elapsed;
+  }
+
+  printf("%-40s %10.1f MB/s %12.0f tokens/s\n", argv[1], length / best / 1e6, tokens / best);
+  free(data);
+  return 0;
+}
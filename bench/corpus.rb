@@ -0,0 +1,111 @@
+# frozen_string_literal: true
+
+# Deterministic documents for the benchmarks, each around `size` bytes.
+# Every document is an array of [kind, string] parts where kind is
+# :html or :placeholder, so ERB-style input can be replayed through
+# Parser#append_placeholder.
+module HtmlTokenizerBench
+  module Corpus
+    WORDS = %w(lorem ipsum dolor sit amet consectetur adipiscing elit sed do
+      eiusmod tempor incididunt ut labore et dolore magna aliqua).freeze
+    MULTIBYTE_WORDS = %w(café naïve 東京 日本語 привет 안녕하세요 ☃ 😀 über façade).freeze
+    TAGS = %w(div span p a li section article header footer td).freeze
+
+    extend self
+
+    def documents(size: 1 << 20, seed: 42)
+      {
+        "text_heavy" => text_heavy(size, Random.new(seed)),
+        "attribute_dense" => attribute_dense(size, Random.new(seed)),
+        "erb_chunked" => erb_chunked(size, Random.new(seed)),
+        "comments_and_scripts" => comments_and_scripts(size, Random.new(seed)),
+        "multibyte_utf8" => multibyte_utf8(size, Random.new(seed)),
+      }
+    end
+
+    # The html parts joined into a single string, placeholders dropped.
+    def source(parts)
+      parts.select { |kind, _| kind == :html }.map(&:last).join
+    end
+
+    private
+
+    def build(size)
+      parts = []
+      bytes = 0
+      while bytes < size
+        part = yield
+        parts << part
+        bytes += part.last.bytesize
+      end
+      parts
+    end
+
+    def sentence(rng, words = WORDS, count = 8 + rng.rand(24))
+      Array.new(count) { words[rng.rand(words.size)] }.join(" ")
+    end
+
+    def text_heavy(size, rng)
+      build(size) do
+        tag = TAGS[rng.rand(TAGS.size)]
+        [:html, "<#{tag}>#{sentence(rng)}.\n#{sentence(rng)}.</#{tag}>\n"]
+      end
+    end
+
+    def attribute_dense(size, rng)
+      build(size) do
+        tag = TAGS[rng.rand(TAGS.size)]
+        attributes = Array.new(3 + rng.rand(6)) do |i|
+          case i % 4
+          when 0 then "class=\"#{sentence(rng, WORDS, 3)}\""
+          when 1 then "data-#{WORDS[rng.rand(WORDS.size)]}-id='#{rng.rand(100_000)}'"
+          when 2 then "href=/#{WORDS[rng.rand(WORDS.size)]}/#{rng.rand(1000)}"
+          else "disabled"
+          end
+        end
+        [:html, "<#{tag} #{attributes.join(' ')}>x</#{tag}>\n"]
+      end
+    end
+
+    def erb_chunked(size, rng)
+      toggle = false
+      build(size) do
+        toggle = !toggle
+        if toggle
+          tag = TAGS[rng.rand(TAGS.size)]
+          [:html, "<#{tag} class=\"#{WORDS[rng.rand(WORDS.size)]}\">#{sentence(rng, WORDS, 4)}</#{tag}>\n"]
+        else
+          [:placeholder, "<%= #{WORDS[rng.rand(WORDS.size)]}.#{WORDS[rng.rand(WORDS.size)]} %>"]
+        end
+      end
+    end
+
+    def comments_and_scripts(size, rng)
+      build(size) do
+        body = Array.new(20 + rng.rand(60)) { sentence(rng) }.join("\n")
+        case rng.rand(3)
+        when 0 then [:html, "<!-- #{body} -->\n"]
+        when 1 then [:html, "<script>var s = '#{body.tr("\n", ' ')}'; if(a < b) { run(); }</script>\n"]
+        else [:html, "<style>.#{WORDS[rng.rand(WORDS.size)]} { content: '#{body.tr("\n", ' ')}'; }</style>\n"]
+        end
+      end
+    end
+
+    def multibyte_utf8(size, rng)
+      build(size) do
+        tag = TAGS[rng.rand(TAGS.size)]
+        [:html, "<#{tag} title=\"#{sentence(rng, MULTIBYTE_WORDS, 2)}\">#{sentence(rng, MULTIBYTE_WORDS)}</#{tag}>\n"]
+      end
+    end
+  end
+end
+
+# Writes each document's html to DIR/<name>.html for bench/c/scan_bench.
+if $PROGRAM_NAME == __FILE__
+  require 'fileutils'
+  dir = ARGV[0] || "tmp/bench"
+  FileUtils.mkdir_p(dir)
+  HtmlTokenizerBench::Corpus.documents.each do |name, parts|
+    File.binwrite(File.join(dir, "#{name}.html"), HtmlTokenizerBench::Corpus.source(parts))
+  end
+end
@@ -0,0 +1,310 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "charclass.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define HAVE_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+#define CC_WHITESPACE 0x01
+#define CC_ATTRIBUTE_NAME 0x02
+#define CC_TAG_NAME_END 0x04
+#define CC_UNQUOTED_VALUE_END 0x08
+
+static unsigned char charclass_table[256];
+
+static long unsigned int scalar_skip(const char *string, long unsigned int length, unsigned char cls)
+{
+  long unsigned int i;
+  for(i = 0; i < length && (charclass_table[(unsigned char)string[i]] & cls); i++) {}
+  return i;
+}
+
+static long unsigned int scalar_find(const char *string, long unsigned int length, unsigned char cls)
+{
+  long unsigned int i;
+  for(i = 0; i < length && !(charclass_table[(unsigned char)string[i]] & cls); i++) {}
+  return i;
+}
+
+static long unsigned int scalar_skip_whitespace(const char *string, long unsigned int length)
+{
+  return scalar_skip(string, length, CC_WHITESPACE);
+}
+
+static long unsigned int scalar_skip_attribute_name(const char *string, long unsigned int length)
+{
+  return scalar_skip(string, length, CC_ATTRIBUTE_NAME);
+}
+
+static long unsigned int scalar_find_tag_name_end(const char *string, long unsigned int length)
+{
+  return scalar_find(string, length, CC_TAG_NAME_END);
+}
+
+static long unsigned int scalar_find_unquoted_value_end(const char *string, long unsigned int length)
+{
+  return scalar_find(string, length, CC_UNQUOTED_VALUE_END);
+}
+
+/* finds the first "cc>", which ends comments (c = '-') and cdata (c = ']') */
+static long unsigned int scalar_find_close_marker(const char *string, long unsigned int length, const char c)
+{
+  const char *p = string, *end = string + length, *close;
+
+  while(p + 2 < end && (close = memchr(p + 2, '>', end - p - 2))) {
+    if(close[-1] == c && close[-2] == c)
+      return close - 2 - string;
+    p = close - 1;
+  }
+  return length;
+}
+
+struct charclass_impl_t {
+  long unsigned int (*skip_whitespace)(const char *string, long unsigned int length);
+  long unsigned int (*skip_attribute_name)(const char *string, long unsigned int length);
+  long unsigned int (*find_tag_name_end)(const char *string, long unsigned int length);
+  long unsigned int (*find_unquoted_value_end)(const char *string, long unsigned int length);
+  long unsigned int (*find_close_marker)(const char *string, long unsigned int length, const char c);
+};
+
+static const struct charclass_impl_t scalar_impl = {
+  scalar_skip_whitespace,
+  scalar_skip_attribute_name,
+  scalar_find_tag_name_end,
+  scalar_find_unquoted_value_end,
+  scalar_find_close_marker,
+};
+
+static const struct charclass_impl_t *impl = &scalar_impl;
+
+#ifdef HAVE_X86_SIMD
+
+/* Scans one vector at a time. member() returns 0xff in every lane whose
+  byte is in the class; find_member picks whether the scan stops on the
+  first member or on the first non-member. The tail is left to the
+  scalar loop so nothing is read past the end of the string. leave()
+  runs before returning, avx2 uses it to clear the upper ymm state which
+  would otherwise slow down the sse code in the rest of the vm. */
+#define DEFINE_SIMD_SCANNER(name, attrs, vec_t, width, load, movemask, leave, member, find_member, cls) \
+  attrs static long unsigned int name(const char *string, long unsigned int length) \
+  { \
+    long unsigned int i; \
+    uint32_t mask; \
+    for(i = 0; i + width <= length; i += width) { \
+      mask = (uint32_t)movemask(member(load((const vec_t *)(string + i)))); \
+      if(!find_member) \
+        mask ^= (uint32_t)((1ULL << width) - 1); \
+      if(mask) { \
+        leave(); \
+        return i + __builtin_ctz(mask); \
+      } \
+    } \
+    leave(); \
+    return i + (find_member ? scalar_find : scalar_skip)(string + i, length - i, cls); \
+  }
+
+/* Compares the marker's three bytes at every offset of the vector at
+  once, so long comments full of '-' or '>' don't fall back to bytes. */
+#define DEFINE_SIMD_MARKER_SEARCH(name, attrs, vec_t, width, load, set1, cmpeq, and, movemask, leave) \
+  attrs static long unsigned int name(const char *string, long unsigned int length, const char c) \
+  { \
+    vec_t repeated = set1(c), close = set1('>'); \
+    long unsigned int i; \
+    uint32_t mask; \
+    for(i = 0; i + width + 2 <= length; i += width) { \
+      mask = (uint32_t)movemask(and( \
+        and(cmpeq(load((const vec_t *)(string + i)), repeated), cmpeq(load((const vec_t *)(string + i + 1)), repeated)), \
+        cmpeq(load((const vec_t *)(string + i + 2)), close))); \
+      if(mask) { \
+        leave(); \
+        return i + __builtin_ctz(mask); \
+      } \
+    } \
+    leave(); \
+    return i + scalar_find_close_marker(string + i, length - i, c); \
+  }
+
+static inline void sse2_leave(void) {}
+
+static inline __m128i sse2_in_range(__m128i v, char lo, char hi)
+{
+  __m128i d = _mm_sub_epi8(v, _mm_set1_epi8(lo));
+  return _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(hi - lo)), d);
+}
+
+static inline __m128i sse2_whitespace(__m128i v)
+{
+  return _mm_or_si128(
+    _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+    _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\r')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'))));
+}
+
+static inline __m128i sse2_attribute_name(__m128i v)
+{
+  /* a-z, A-Z, 0-9, ':', '-', '_' and '.'; '-' to ':' is one range minus '/' */
+  __m128i alpha = sse2_in_range(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 'z');
+  __m128i punct = _mm_andnot_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('/')), sse2_in_range(v, '-', ':'));
+  return _mm_or_si128(_mm_or_si128(alpha, punct), _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+}
+
+static inline __m128i sse2_unquoted_value_end(__m128i v)
+{
+  return _mm_or_si128(sse2_whitespace(v), _mm_cmpeq_epi8(v, _mm_set1_epi8('>')));
+}
+
+static inline __m128i sse2_tag_name_end(__m128i v)
+{
+  return _mm_or_si128(sse2_unquoted_value_end(v), _mm_cmpeq_epi8(v, _mm_set1_epi8('/')));
+}
+
+DEFINE_SIMD_SCANNER(sse2_skip_whitespace, , __m128i, 16, _mm_loadu_si128, _mm_movemask_epi8, sse2_leave,
+  sse2_whitespace, 0, CC_WHITESPACE)
+DEFINE_SIMD_SCANNER(sse2_skip_attribute_name, , __m128i, 16, _mm_loadu_si128, _mm_movemask_epi8, sse2_leave,
+  sse2_attribute_name, 0, CC_ATTRIBUTE_NAME)
+DEFINE_SIMD_SCANNER(sse2_find_tag_name_end, , __m128i, 16, _mm_loadu_si128, _mm_movemask_epi8, sse2_leave,
+  sse2_tag_name_end, 1, CC_TAG_NAME_END)
+DEFINE_SIMD_SCANNER(sse2_find_unquoted_value_end, , __m128i, 16, _mm_loadu_si128, _mm_movemask_epi8, sse2_leave,
+  sse2_unquoted_value_end, 1, CC_UNQUOTED_VALUE_END)
+
+DEFINE_SIMD_MARKER_SEARCH(sse2_find_close_marker, , __m128i, 16, _mm_loadu_si128, _mm_set1_epi8,
+  _mm_cmpeq_epi8, _mm_and_si128, _mm_movemask_epi8, sse2_leave)
+
+static const struct charclass_impl_t sse2_impl = {
+  sse2_skip_whitespace,
+  sse2_skip_attribute_name,
+  sse2_find_tag_name_end,
+  sse2_find_unquoted_value_end,
+  sse2_find_close_marker,
+};
+
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 static inline __m256i avx2_in_range(__m256i v, char lo, char hi)
+{
+  __m256i d = _mm256_sub_epi8(v, _mm256_set1_epi8(lo));
+  return _mm256_cmpeq_epi8(_mm256_min_epu8(d, _mm256_set1_epi8(hi - lo)), d);
+}
+
+AVX2 static inline __m256i avx2_whitespace(__m256i v)
+{
+  return _mm256_or_si256(
+    _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))),
+    _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n'))));
+}
+
+AVX2 static inline __m256i avx2_attribute_name(__m256i v)
+{
+  __m256i alpha = avx2_in_range(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), 'a', 'z');
+  __m256i punct = _mm256_andnot_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('/')), avx2_in_range(v, '-', ':'));
+  return _mm256_or_si256(_mm256_or_si256(alpha, punct), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')));
+}
+
+AVX2 static inline __m256i avx2_unquoted_value_end(__m256i v)
+{
+  return _mm256_or_si256(avx2_whitespace(v), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('>')));
+}
+
+AVX2 static inline __m256i avx2_tag_name_end(__m256i v)
+{
+  return _mm256_or_si256(avx2_unquoted_value_end(v), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('/')));
+}
+
+DEFINE_SIMD_SCANNER(avx2_skip_whitespace, AVX2, __m256i, 32, _mm256_loadu_si256, _mm256_movemask_epi8, _mm256_zeroupper,
+  avx2_whitespace, 0, CC_WHITESPACE)
+DEFINE_SIMD_SCANNER(avx2_skip_attribute_name, AVX2, __m256i, 32, _mm256_loadu_si256, _mm256_movemask_epi8, _mm256_zeroupper,
+  avx2_attribute_name, 0, CC_ATTRIBUTE_NAME)
+DEFINE_SIMD_SCANNER(avx2_find_tag_name_end, AVX2, __m256i, 32, _mm256_loadu_si256, _mm256_movemask_epi8, _mm256_zeroupper,
+  avx2_tag_name_end, 1, CC_TAG_NAME_END)
+DEFINE_SIMD_SCANNER(avx2_find_unquoted_value_end, AVX2, __m256i, 32, _mm256_loadu_si256, _mm256_movemask_epi8, _mm256_zeroupper,
+  avx2_unquoted_value_end, 1, CC_UNQUOTED_VALUE_END)
+
+DEFINE_SIMD_MARKER_SEARCH(avx2_find_close_marker, AVX2, __m256i, 32, _mm256_loadu_si256, _mm256_set1_epi8,
+  _mm256_cmpeq_epi8, _mm256_and_si256, _mm256_movemask_epi8, _mm256_zeroupper)
+
+static const struct charclass_impl_t avx2_impl = {
+  avx2_skip_whitespace,
+  avx2_skip_attribute_name,
+  avx2_find_tag_name_end,
+  avx2_find_unquoted_value_end,
+  avx2_find_close_marker,
+};
+
+#endif
+
+/* Picks the widest kernels the cpu supports. HTML_TOKENIZER_SIMD can be
+  set to scalar, sse2 or avx2 to force a narrower implementation. */
+void charclass_init(void)
+{
+  const char *requested = getenv("HTML_TOKENIZER_SIMD");
+  int c;
+
+  for(c = 0; c < 256; c++) {
+    charclass_table[c] = 0;
+    if(c == ' ' || c == '\t' || c == '\r' || c == '\n')
+      charclass_table[c] |= CC_WHITESPACE | CC_TAG_NAME_END | CC_UNQUOTED_VALUE_END;
+    if((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+        c == ':' || c == '-' || c == '_' || c == '.')
+      charclass_table[c] |= CC_ATTRIBUTE_NAME;
+    if(c == '>')
+      charclass_table[c] |= CC_TAG_NAME_END | CC_UNQUOTED_VALUE_END;
+    if(c == '/')
+      charclass_table[c] |= CC_TAG_NAME_END;
+  }
+
+  impl = &scalar_impl;
+#ifdef HAVE_X86_SIMD
+  if(requested && !strcmp(requested, "scalar"))
+    return;
+  impl = &sse2_impl;
+  if(requested && !strcmp(requested, "sse2"))
+    return;
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("avx2"))
+    impl = &avx2_impl;
+#else
+  (void)requested;
+#endif
+}
+
+long unsigned int charclass_skip_whitespace(const char *string, long unsigned int length)
+{
+  if(!length || !(charclass_table[(unsigned char)string[0]] & CC_WHITESPACE))
+    return 0;
+  return impl->skip_whitespace(string, length);
+}
+
+long unsigned int charclass_skip_attribute_name(const char *string, long unsigned int length)
+{
+  if(!length || !(charclass_table[(unsigned char)string[0]] & CC_ATTRIBUTE_NAME))
+    return 0;
+  return impl->skip_attribute_name(string, length);
+}
+
+long unsigned int charclass_find_tag_name_end(const char *string, long unsigned int length)
+{
+  if(!length || (charclass_table[(unsigned char)string[0]] & CC_TAG_NAME_END))
+    return 0;
+  return impl->find_tag_name_end(string, length);
+}
+
+long unsigned int charclass_find_unquoted_value_end(const char *string, long unsigned int length)
+{
+  if(!length || (charclass_table[(unsigned char)string[0]] & CC_UNQUOTED_VALUE_END))
+    return 0;
+  return impl->find_unquoted_value_end(string, length);
+}
+
+long unsigned int charclass_find_close_marker(const char *string, long unsigned int length, const char c)
+{
+  return impl->find_close_marker(string, length, c);
+}
+
+/* libc memchr is already vectorized and dispatched at runtime */
+long unsigned int charclass_find_char(const char *string, long unsigned int length, const char c)
+{
+  const char *found = memchr(string, c, length);
+  return found ? (long unsigned int)(found - string) : length;
+}
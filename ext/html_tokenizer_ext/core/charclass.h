@@ -0,0 +1,10 @@
+#pragma once
+
+void charclass_init(void);
+
+long unsigned int charclass_skip_whitespace(const char *string, long unsigned int length);
+long unsigned int charclass_skip_attribute_name(const char *string, long unsigned int length);
+long unsigned int charclass_find_tag_name_end(const char *string, long unsigned int length);
+long unsigned int charclass_find_unquoted_value_end(const char *string, long unsigned int length);
+long unsigned int charclass_find_char(const char *string, long unsigned int length, const char c);
+long unsigned int charclass_find_close_marker(const char *string, long unsigned int length, const char c);
@@ -0,0 +1,74 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "hooks.h"
+#include "charclass.h"
+
+static void *default_realloc(void *ptr, size_t size)
+{
+  return realloc(ptr, size);
+}
+
+static void default_free(void *ptr)
+{
+  free(ptr);
+}
+
+static enum ht_encoding_kind default_encoding_kind(int enc_index)
+{
+  return HT_ENCODING_UTF8;
+}
+
+static long unsigned int default_advance(int enc_index, const char *buf, long unsigned int length,
+  long unsigned int *line_number, long unsigned int *column_number)
+{
+  long unsigned int i;
+
+  for(i = 0; i < length; i++) {
+    if(buf[i] == '\n') {
+      *line_number += 1;
+      *column_number = 0;
+    }
+    else
+      *column_number += 1;
+  }
+  return length;
+}
+
+static void default_error(const char *message)
+{
+  fprintf(stderr, "html_tokenizer: %s\n", message);
+  abort();
+}
+
+struct ht_hooks_t ht_hooks = {
+  default_realloc,
+  default_free,
+  default_encoding_kind,
+  default_advance,
+  default_error,
+};
+
+void ht_init(const struct ht_hooks_t *hooks)
+{
+  if(hooks)
+    ht_hooks = *hooks;
+  charclass_init();
+}
+
+void *ht_realloc(void *ptr, size_t size)
+{
+  if(size == 0) {
+    ht_hooks.free(ptr);
+    return NULL;
+  }
+  ptr = ht_hooks.realloc(ptr, size);
+  if(!ptr)
+    ht_hooks.error("out of memory");
+  return ptr;
+}
+
+void ht_free(void *ptr)
+{
+  if(ptr)
+    ht_hooks.free(ptr);
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <stddef.h>
+
+/* How position_advance counts the characters of an encoding. */
+enum ht_encoding_kind {
+  HT_ENCODING_UTF8 = 0,
+  HT_ENCODING_SINGLE_BYTE,
+  HT_ENCODING_MULTIBYTE, // counted by ht_hooks.advance
+};
+
+/* What the core library needs from its host. The Ruby extension routes
+  these to the Ruby allocator, Ruby encodings and rb_raise. */
+struct ht_hooks_t {
+  void *(*realloc)(void *ptr, size_t size);
+  void (*free)(void *ptr);
+  enum ht_encoding_kind (*encoding_kind)(int enc_index);
+  long unsigned int (*advance)(int enc_index, const char *buf, long unsigned int length,
+    long unsigned int *line_number, long unsigned int *column_number);
+  /* must not return, the core does not unwind after an error */
+  void (*error)(const char *message);
+};
+
+extern struct ht_hooks_t ht_hooks;
+
+/* Installs the host hooks, NULL for the libc defaults which treat every
+  encoding as utf-8 and abort on error. Must be called once before
+  anything else in the core library. */
+void ht_init(const struct ht_hooks_t *hooks);
+
+void *ht_realloc(void *ptr, size_t size);
+void ht_free(void *ptr);
+
+#define HT_REALLOC_N(var, type, n) ((var) = (type *)ht_realloc((void *)(var), sizeof(type) * (n)))
@@ -0,0 +1,855 @@
+#include <string.h>
+#include "debug.h"
+#include "hooks.h"
+#include "parser.h"
+#include "position.h"
+
+static inline void parser_append_ref(struct token_reference_t *dest, struct token_reference_t *src)
+{
+  if(dest->type == TOKEN_NONE || dest->type != src->type || (dest->start + dest->length) != src->start) {
+    dest->type = src->type;
+    dest->start = src->start;
+    dest->mb_start = src->mb_start;
+    dest->length = src->length;
+    dest->mb_length = src->mb_length;
+  }
+  else {
+    dest->type = src->type;
+    dest->length += src->length;
+    dest->mb_length += src->mb_length;
+  }
+}
+
+static const char *parser_error_messages[PARSER_ERROR_COUNT] = {
+  [PARSER_ERROR_SOLIDUS_OR_TAG_NAME] = "expected '/' or tag name",
+  [PARSER_ERROR_TAG] = "expected whitespace, '>', attribute name or value",
+  [PARSER_ERROR_TAG_END] = "expected '>' after '/'",
+  [PARSER_ERROR_ATTRIBUTE_NAME] = "expected whitespace, '>' or '=' after attribute name",
+  [PARSER_ERROR_ATTRIBUTE_WHITESPACE_OR_EQUAL] = "expected '/', '>', \", ' or '=' after attribute name",
+  [PARSER_ERROR_ATTRIBUTE_VALUE] = "expected attribute value after '='",
+  [PARSER_ERROR_SPACE_AFTER_ATTRIBUTE] = "expected space after attribute value",
+};
+
+const char *parser_error_message(enum parser_error error)
+{
+  if((unsigned int)error >= PARSER_ERROR_COUNT)
+    return NULL;
+  return parser_error_messages[error];
+}
+
+static void parser_add_error(struct parser_t *parser, enum parser_error error)
+{
+  struct parser_document_error_t *entry;
+
+  if(parser->errors_count == parser->errors_capacity) {
+    parser->errors_capacity = parser->errors_capacity ?
+      parser->errors_capacity * 2 : PARSER_ERRORS_MIN_CAPACITY;
+    HT_REALLOC_N(parser->errors, struct parser_document_error_t, parser->errors_capacity);
+    DBG_PRINT("parser=%p realloc(parser->errors) %p capacity=%lu", parser,
+      parser->errors, parser->errors_capacity);
+  }
+
+  entry = &parser->errors[parser->errors_count++];
+  entry->error = error;
+  entry->pos = parser->tk.scan.cursor;
+  entry->mb_pos = parser->tk.scan.mb_cursor;
+  return;
+}
+
+static void parser_flush_text(struct parser_t *parser)
+{
+  struct parser_event_t event;
+
+  if(parser->pending_text.type == TOKEN_NONE)
+    return;
+  event.type = PARSER_EVENT_TEXT;
+  event.span = parser->pending_text;
+  event.text = parser->pending_text;
+  event.attributes = NULL;
+  event.attributes_count = 0;
+  event.self_closing = 0;
+  parser->pending_text.type = TOKEN_NONE;
+  parser->f_event(parser, &event, parser->callback_data);
+}
+
+/* Text tokens are joined into one run while they follow each other. */
+static void parser_add_text(struct parser_t *parser, struct token_reference_t *ref)
+{
+  struct token_reference_t *text = &parser->pending_text;
+
+  if(!parser->f_event)
+    return;
+  if(text->type != TOKEN_NONE && text->start + text->length != ref->start)
+    parser_flush_text(parser);
+  parser_append_ref(text, ref);
+}
+
+static void parser_open_attribute(struct parser_t *parser)
+{
+  parser->attribute.name.type = TOKEN_NONE;
+  parser->attribute.value.type = TOKEN_NONE;
+  parser->attribute.is_quoted = 0;
+  parser->is_attribute_open = parser->f_event != NULL;
+}
+
+static void parser_close_attribute(struct parser_t *parser)
+{
+  if(!parser->is_attribute_open)
+    return;
+  parser->is_attribute_open = 0;
+  if(parser->attributes_count == parser->attributes_capacity) {
+    parser->attributes_capacity = parser->attributes_capacity ?
+      parser->attributes_capacity * 2 : PARSER_ATTRIBUTES_MIN_CAPACITY;
+    HT_REALLOC_N(parser->attributes, struct parser_attribute_t, parser->attributes_capacity);
+    DBG_PRINT("parser=%p realloc(parser->attributes) %p capacity=%lu", parser,
+      parser->attributes, parser->attributes_capacity);
+  }
+  parser->attributes[parser->attributes_count++] = parser->attribute;
+}
+
+/* Reports the construct that opened at event_start and closes with ref. */
+static void parser_emit(struct parser_t *parser, enum parser_event_type type, struct token_reference_t *ref, struct token_reference_t *text)
+{
+  struct parser_event_t event;
+
+  if(!parser->f_event)
+    return;
+  parser_flush_text(parser);
+  parser_close_attribute(parser);
+
+  event.type = type;
+  event.span = parser->event_start;
+  event.span.length = ref->start + ref->length - event.span.start;
+  event.span.mb_length = ref->mb_start + ref->mb_length - event.span.mb_start;
+  event.text = *text;
+  if(type == PARSER_EVENT_START_TAG || type == PARSER_EVENT_END_TAG) {
+    event.attributes = parser->attributes;
+    event.attributes_count = parser->attributes_count;
+    event.self_closing = parser->tag.self_closing;
+  }
+  else {
+    event.attributes = NULL;
+    event.attributes_count = 0;
+    event.self_closing = 0;
+  }
+  parser->f_event(parser, &event, parser->callback_data);
+}
+
+static void parser_emit_tag(struct parser_t *parser, struct token_reference_t *ref)
+{
+  parser_emit(parser, parser->tk.is_closing_tag ? PARSER_EVENT_END_TAG : PARSER_EVENT_START_TAG,
+    ref, &parser->tag.name);
+}
+
+static int parse_none(struct parser_t *parser, struct token_reference_t *ref)
+{
+  if(ref->type == TOKEN_TAG_START) {
+    parser->tag.self_closing = 0;
+    parser->context = PARSER_SOLIDUS_OR_TAG_NAME;
+    parser->tag.name.type = TOKEN_NONE;
+    parser->event_start = *ref;
+    parser->attributes_count = 0;
+    parser->is_attribute_open = 0;
+  }
+  else if(ref->type == TOKEN_COMMENT_START) {
+    parser->context = PARSER_COMMENT;
+    parser->comment.text.type = TOKEN_NONE;
+    parser->event_start = *ref;
+  }
+  else if(ref->type == TOKEN_CDATA_START) {
+    parser->context = PARSER_CDATA;
+    parser->cdata.text.type = TOKEN_NONE;
+    parser->event_start = *ref;
+  }
+  else if(ref->type == TOKEN_TEXT) {
+    parser_add_text(parser, ref);
+  }
+  PARSE_DONE;
+}
+
+static int parse_rawtext(struct parser_t *parser, struct token_reference_t *ref)
+{
+  if(ref->type == TOKEN_TEXT) {
+    parser_append_ref(&parser->rawtext.text, ref);
+    parser_add_text(parser, ref);
+  }
+  else {
+    parser->context = PARSER_NONE;
+    parse_none(parser, ref);
+  }
+  PARSE_DONE;
+}
+
+static int parse_comment(struct parser_t *parser, struct token_reference_t *ref)
+{
+  if(ref->type == TOKEN_COMMENT_END) {
+    parser->context = PARSER_NONE;
+    parser_emit(parser, PARSER_EVENT_COMMENT, ref, &parser->comment.text);
+  }
+  else if(ref->type == TOKEN_TEXT) {
+    parser_append_ref(&parser->comment.text, ref);
+  }
+  PARSE_DONE;
+}
+
+static int parse_cdata(struct parser_t *parser, struct token_reference_t *ref)
+{
+  if(ref->type == TOKEN_CDATA_END) {
+    parser->context = PARSER_NONE;
+    parser_emit(parser, PARSER_EVENT_CDATA, ref, &parser->cdata.text);
+  }
+  else if(ref->type == TOKEN_TEXT) {
+    parser_append_ref(&parser->cdata.text, ref);
+  }
+  PARSE_DONE;
+}
+
+static int parse_solidus_or_tag_name(struct parser_t *parser, struct token_reference_t *ref)
+{
+  if(ref->type == TOKEN_SOLIDUS) {
+    // ignore solidus before tag name
+    parser->context = PARSER_TAG_NAME;
+  }
+  else if(ref->type == TOKEN_TAG_NAME) {
+    parser->context = PARSER_TAG_NAME;
+    PARSE_AGAIN;
+  }
+  else {
+    parser_add_error(parser, PARSER_ERROR_SOLIDUS_OR_TAG_NAME);
+    parser->context = PARSER_TAG;
+    PARSE_AGAIN;
+  }
+  PARSE_DONE;
+}
+
+static int parse_tag_name(struct parser_t *parser, struct token_reference_t *ref)
+{
+  if(ref->type == TOKEN_TAG_NAME) {
+    parser_append_ref(&parser->tag.name, ref);
+  }
+  else if(ref->type == TOKEN_WHITESPACE) {
+    parser->context = PARSER_TAG;
+  }
+  else if(ref->type == TOKEN_TAG_END) {
+    parser->context = PARSER_NONE;
+    parser_emit_tag(parser, ref);
+  }
+  else if(ref->type == TOKEN_SOLIDUS) {
+    parser->context = PARSER_TAG;
+    PARSE_AGAIN;
+  }
+  else {
+    // not reachable
+    ht_hooks.error("expected whitespace, '/' or '>' after tag name");
+  }
+  PARSE_DONE;
+}
+
+static int parse_tag(struct parser_t *parser, struct token_reference_t *ref)
+{
+  if(ref->type == TOKEN_TAG_END) {
+    parser->context = PARSER_NONE;
+    parser_emit_tag(parser, ref);
+  }
+  else if(ref->type == TOKEN_WHITESPACE) {
+    // ignore whitespaces
+  }
+  else if(ref->type == TOKEN_SOLIDUS) {
+    parser->context = PARSER_TAG_END;
+  }
+  else if(ref->type == TOKEN_ATTRIBUTE_NAME) {
+    parser->context = PARSER_ATTRIBUTE_NAME;
+    parser_close_attribute(parser);
+    parser_open_attribute(parser);
+    PARSE_AGAIN;
+  }
+  else if(ref->type == TOKEN_ATTRIBUTE_QUOTED_VALUE_START) {
+    parser->context = PARSER_ATTRIBUTE_QUOTED_VALUE;
+    parser_close_attribute(parser);
+    parser_open_attribute(parser);
+    parser->attribute.is_quoted = 1;
+  }
+  else {
+    // unexpected
+    parser_add_error(parser, PARSER_ERROR_TAG);
+  }
+  PARSE_DONE;
+}
+
+static int parse_tag_end(struct parser_t *parser, struct token_reference_t *ref)
+{
+  if(ref->type == TOKEN_TAG_END) {
+    parser->tag.self_closing = 1;
+    parser->context = PARSER_NONE;
+    parser_emit_tag(parser, ref);
+  }
+  else {
+    parser_add_error(parser, PARSER_ERROR_TAG_END);
+    parser->context = PARSER_TAG;
+    PARSE_AGAIN;
+  }
+  PARSE_DONE;
+}
+
+static int parse_attribute_name(struct parser_t *parser, struct token_reference_t *ref)
+{
+  if(ref->type == TOKEN_ATTRIBUTE_NAME) {
+    parser_append_ref(&parser->attribute.name, ref);
+  }
+  else if(ref->type == TOKEN_TAG_END || ref->type == TOKEN_SOLIDUS) {
+    parser->context = PARSER_TAG;
+    PARSE_AGAIN;
+  }
+  else if(ref->type == TOKEN_WHITESPACE) {
+    parser->context = PARSER_ATTRIBUTE_WHITESPACE_OR_EQUAL;
+    PARSE_AGAIN;
+  }
+  else if(ref->type == TOKEN_EQUAL) {
+    parser->context = PARSER_ATTRIBUTE_WHITESPACE_OR_VALUE;
+  }
+  else {
+    parser_add_error(parser, PARSER_ERROR_ATTRIBUTE_NAME);
+    parser->context = PARSER_TAG;
+    PARSE_AGAIN;
+  }
+  PARSE_DONE;
+}
+
+static int parse_attribute_whitespace_or_equal(struct parser_t *parser, struct token_reference_t *ref)
+{
+  if(ref->type == TOKEN_WHITESPACE) {
+    // swallow whitespace after attribute name
+  }
+  else if(ref->type == TOKEN_TAG_END || ref->type == TOKEN_SOLIDUS) {
+    parser->context = PARSER_TAG;
+    PARSE_AGAIN;
+  }
+  else if(ref->type == TOKEN_EQUAL) {
+    parser->context = PARSER_ATTRIBUTE_WHITESPACE_OR_VALUE;
+  }
+  else if(ref->type == TOKEN_ATTRIBUTE_NAME) {
+    // start new attribute after whitespace
+    parser->context = PARSER_TAG;
+    PARSE_AGAIN;
+  }
+  else if(ref->type == TOKEN_ATTRIBUTE_QUOTED_VALUE_START) {
+    // start quoted value after whitespace
+    parser->context = PARSER_TAG;
+    PARSE_AGAIN;
+  }
+  else {
+    parser_add_error(parser, PARSER_ERROR_ATTRIBUTE_WHITESPACE_OR_EQUAL);
+    parser->context = PARSER_TAG;
+    PARSE_AGAIN;
+  }
+
+  PARSE_DONE;
+}
+
+static int parse_attribute_whitespace_or_value(struct parser_t *parser, struct token_reference_t *ref)
+{
+  if(ref->type == TOKEN_WHITESPACE) {
+    // swallow whitespace after equal sign
+  }
+  else if(ref->type == TOKEN_ATTRIBUTE_QUOTED_VALUE_START) {
+    parser->context = PARSER_ATTRIBUTE_QUOTED_VALUE;
+    parser->attribute.is_quoted = 1;
+  }
+  else if(ref->type == TOKEN_ATTRIBUTE_UNQUOTED_VALUE) {
+    parser->context = PARSER_ATTRIBUTE_UNQUOTED_VALUE;
+    PARSE_AGAIN;
+  }
+  else {
+    parser_add_error(parser, PARSER_ERROR_ATTRIBUTE_VALUE);
+    parser->context = PARSER_TAG;
+    PARSE_AGAIN;
+  }
+
+  PARSE_DONE;
+}
+
+static int parse_attribute_quoted_value(struct parser_t *parser, struct token_reference_t *ref)
+{
+  if(ref->type == TOKEN_ATTRIBUTE_QUOTED_VALUE) {
+    parser_append_ref(&parser->attribute.value, ref);
+  }
+  else if(ref->type == TOKEN_ATTRIBUTE_QUOTED_VALUE_END) {
+    parser->context = PARSER_SPACE_AFTER_ATTRIBUTE;
+  }
+  else {
+    // not reachable
+    ht_hooks.error("expected end-quote after quoted value");
+  }
+
+  PARSE_DONE;
+}
+
+static int parse_space_after_attribute(struct parser_t *parser, struct token_reference_t *ref)
+{
+  if(ref->type == TOKEN_WHITESPACE) {
+    parser->context = PARSER_TAG;
+  }
+  else if(ref->type == TOKEN_TAG_END || ref->type == TOKEN_SOLIDUS) {
+    parser->context = PARSER_TAG;
+    PARSE_AGAIN;
+  }
+  else {
+    parser_add_error(parser, PARSER_ERROR_SPACE_AFTER_ATTRIBUTE);
+    parser->context = PARSER_TAG;
+    PARSE_AGAIN;
+  }
+
+  PARSE_DONE;
+}
+
+static int parse_attribute_unquoted_value(struct parser_t *parser, struct token_reference_t *ref)
+{
+  if(ref->type == TOKEN_ATTRIBUTE_UNQUOTED_VALUE) {
+    parser_append_ref(&parser->attribute.value, ref);
+  }
+  else if(ref->type == TOKEN_WHITESPACE) {
+    parser->context = PARSER_TAG;
+  }
+  else if(ref->type == TOKEN_TAG_END || ref->type == TOKEN_SOLIDUS) {
+    parser->context = PARSER_TAG;
+    PARSE_AGAIN;
+  }
+  else {
+    // not reachable
+    ht_hooks.error("expected space or end-of-tag after unquoted value");
+  }
+
+  PARSE_DONE;
+}
+
+int parser_in_rawtext(const struct parser_t *parser)
+{
+  enum tokenizer_context ctx = parser->tk.context[parser->tk.current_context];
+  return (ctx == TOKENIZER_RCDATA || ctx == TOKENIZER_RAWTEXT ||
+      ctx == TOKENIZER_SCRIPT_DATA || ctx == TOKENIZER_PLAINTEXT);
+}
+
+static void parser_tokenize_callback(struct tokenizer_t *tk, enum token_type type, unsigned long int length, unsigned long int mb_length, void *data)
+{
+  struct parser_t *parser = (struct parser_t *)data;
+  struct token_reference_t ref = {
+    .type = type,
+    .start = tk->scan.cursor,
+    .mb_start = tk->scan.mb_cursor,
+    .length = length,
+    .mb_length = mb_length,
+  };
+  int parse_again = 1;
+
+  while(parse_again) {
+    switch(parser->context)
+    {
+    case PARSER_NONE:
+      if(parser_in_rawtext(parser))
+        parse_again = parse_rawtext(parser, &ref);
+      else
+        parse_again = parse_none(parser, &ref);
+      break;
+    case PARSER_SOLIDUS_OR_TAG_NAME:
+      parse_again = parse_solidus_or_tag_name(parser, &ref);
+      break;
+    case PARSER_TAG_NAME:
+      parse_again = parse_tag_name(parser, &ref);
+      break;
+    case PARSER_TAG:
+      parse_again = parse_tag(parser, &ref);
+      break;
+    case PARSER_ATTRIBUTE_NAME:
+      parse_again = parse_attribute_name(parser, &ref);
+      break;
+    case PARSER_ATTRIBUTE_WHITESPACE_OR_EQUAL:
+      parse_again = parse_attribute_whitespace_or_equal(parser, &ref);
+      break;
+    case PARSER_ATTRIBUTE_WHITESPACE_OR_VALUE:
+      parse_again = parse_attribute_whitespace_or_value(parser, &ref);
+      break;
+    case PARSER_ATTRIBUTE_QUOTED_VALUE:
+      parse_again = parse_attribute_quoted_value(parser, &ref);
+      break;
+    case PARSER_SPACE_AFTER_ATTRIBUTE:
+      parse_again = parse_space_after_attribute(parser, &ref);
+      break;
+    case PARSER_ATTRIBUTE_UNQUOTED_VALUE:
+      parse_again = parse_attribute_unquoted_value(parser, &ref);
+      break;
+    case PARSER_TAG_END:
+      parse_again = parse_tag_end(parser, &ref);
+      break;
+    case PARSER_CDATA:
+      parse_again = parse_cdata(parser, &ref);
+      break;
+    case PARSER_COMMENT:
+      parse_again = parse_comment(parser, &ref);
+      break;
+    }
+  }
+
+  if(parser->f_callback && (parser->token_mask & TOKEN_MASK(type)))
+    parser->f_callback(parser, type, length, mb_length, parser->callback_data);
+
+  return;
+}
+
+void parser_init(struct parser_t *parser)
+{
+  memset(parser, 0, sizeof(struct parser_t));
+
+  parser->context = PARSER_NONE;
+
+  tokenizer_init(&parser->tk);
+  parser->tk.callback_data = parser;
+  parser->tk.f_callback = parser_tokenize_callback;
+  parser->tk.scan.count_lines = 0;
+
+  parser->doc.length = 0;
+  parser->doc.capacity = 0;
+  parser->doc.data = NULL;
+  parser->doc.is_started = 0;
+  parser->doc.enc_index = 0;
+  parser->doc.enc_kind = HT_ENCODING_UTF8;
+  parser->doc.mb_length = 0;
+
+  parser->errors_count = 0;
+  parser->errors_capacity = 0;
+  parser->errors = NULL;
+
+  parser->callback_data = NULL;
+  parser->f_callback = NULL;
+  parser->token_mask = TOKEN_MASK_ALL;
+  parser->f_event = NULL;
+  return;
+}
+
+void parser_free_members(struct parser_t *parser)
+{
+  tokenizer_free_members(&parser->tk);
+  if(parser->doc.data) {
+    DBG_PRINT("parser=%p ht_free(parser->doc.data) %p", parser, parser->doc.data);
+    ht_free(parser->doc.data);
+    parser->doc.data = NULL;
+  }
+  if(parser->errors) {
+    DBG_PRINT("parser=%p ht_free(parser->errors) %p", parser, parser->errors);
+    ht_free(parser->errors);
+    parser->errors = NULL;
+    parser->errors_count = 0;
+    parser->errors_capacity = 0;
+  }
+  if(parser->attributes) {
+    DBG_PRINT("parser=%p ht_free(parser->attributes) %p", parser, parser->attributes);
+    ht_free(parser->attributes);
+    parser->attributes = NULL;
+    parser->attributes_count = 0;
+    parser->attributes_capacity = 0;
+  }
+  if(parser->lines.starts) {
+    DBG_PRINT("parser=%p ht_free(parser->lines.starts) %p", parser, parser->lines.starts);
+    ht_free(parser->lines.starts);
+    parser->lines.starts = NULL;
+    parser->lines.count = 0;
+    parser->lines.capacity = 0;
+  }
+  if(parser->lines.appends) {
+    DBG_PRINT("parser=%p ht_free(parser->lines.appends) %p", parser, parser->lines.appends);
+    ht_free(parser->lines.appends);
+    parser->lines.appends = NULL;
+    parser->lines.appends_count = 0;
+    parser->lines.appends_capacity = 0;
+  }
+  return;
+}
+
+/* Starts over on a new document like parser_init, keeping the document
+  and error buffers allocated for it. */
+void parser_reset(struct parser_t *parser)
+{
+  char *data = parser->doc.data;
+  long unsigned int capacity = parser->doc.capacity;
+  struct parser_document_error_t *errors = parser->errors;
+  size_t errors_capacity = parser->errors_capacity;
+  struct parser_attribute_t *attributes = parser->attributes;
+  size_t attributes_capacity = parser->attributes_capacity;
+  struct parser_line_index_t lines = parser->lines;
+
+  tokenizer_free_members(&parser->tk);
+  parser_init(parser);
+  parser->doc.data = data;
+  parser->doc.capacity = capacity;
+  parser->errors = errors;
+  parser->errors_capacity = errors_capacity;
+  parser->attributes = attributes;
+  parser->attributes_capacity = attributes_capacity;
+  parser->lines.starts = lines.starts;
+  parser->lines.capacity = lines.capacity;
+  parser->lines.appends = lines.appends;
+  parser->lines.appends_capacity = lines.appends_capacity;
+  return;
+}
+
+/* Bytes parser holds on the heap besides itself. */
+size_t parser_allocated_size(const struct parser_t *parser)
+{
+  return tokenizer_allocated_size(&parser->tk) + parser->doc.capacity +
+    parser->errors_capacity * sizeof(struct parser_document_error_t) +
+    parser->attributes_capacity * sizeof(struct parser_attribute_t) +
+    parser_lines_allocated_size(parser);
+}
+
+size_t parser_lines_allocated_size(const struct parser_t *parser)
+{
+  return (parser->lines.capacity + parser->lines.appends_capacity) * sizeof(struct parser_offset_t);
+}
+
+static void parser_push_offset(struct parser_offset_t **list, size_t *count, size_t *capacity,
+  long unsigned int pos, long unsigned int mb_pos)
+{
+  if(*count == *capacity) {
+    *capacity = *capacity ? *capacity * 2 : PARSER_LINES_MIN_CAPACITY;
+    HT_REALLOC_N(*list, struct parser_offset_t, *capacity);
+  }
+  (*list)[*count].pos = pos;
+  (*list)[*count].mb_pos = mb_pos;
+  *count += 1;
+}
+
+/* Indexes the lines that start up to pos, a token boundary or the end
+  of an append at mb_pos characters. */
+static void parser_index_lines(struct parser_t *parser, long unsigned int pos, long unsigned int mb_pos)
+{
+  struct parser_line_index_t *lines = &parser->lines;
+  const char *data = parser->doc.data, *newline;
+  long unsigned int end;
+
+  if(pos <= lines->indexed.pos)
+    return;
+
+  while(1) {
+    while(lines->next_append < lines->appends_count && lines->appends[lines->next_append].pos <= lines->indexed.pos)
+      lines->next_append++;
+    end = pos;
+    if(lines->next_append < lines->appends_count && lines->appends[lines->next_append].pos < end)
+      end = lines->appends[lines->next_append].pos;
+
+    newline = memchr(data + lines->indexed.pos, '\n', end - lines->indexed.pos);
+    if(newline) {
+      lines->indexed.mb_pos += position_advance(parser->doc.enc_kind, parser->doc.enc_index,
+        data + lines->indexed.pos, newline + 1 - (data + lines->indexed.pos), NULL, NULL);
+      lines->indexed.pos = newline + 1 - data;
+      parser_push_offset(&lines->starts, &lines->count, &lines->capacity,
+        lines->indexed.pos, lines->indexed.mb_pos);
+    }
+    else if(end < pos) {
+      lines->indexed = lines->appends[lines->next_append];
+    }
+    else {
+      break;
+    }
+  }
+  lines->indexed.pos = pos;
+  lines->indexed.mb_pos = mb_pos;
+}
+
+/* Line and column of the token boundary at pos, mb_pos characters into
+  the document. Lookups usually move forward a line at a time, so the
+  line of the last one is tried before searching. */
+void parser_line_and_column(struct parser_t *parser, long unsigned int pos, long unsigned int mb_pos,
+  long unsigned int *line_number, long unsigned int *column_number)
+{
+  struct parser_line_index_t *lines = &parser->lines;
+  size_t low = 0, high, mid, hint = lines->hint;
+
+  parser_index_lines(parser, pos, mb_pos);
+
+  /* count the line starts at or before pos */
+  high = lines->count;
+  if(hint <= lines->count && (hint == 0 || lines->starts[hint - 1].pos <= pos)) {
+    low = hint;
+    if(hint == lines->count || lines->starts[hint].pos > pos)
+      high = hint;
+    else if(hint + 1 == lines->count || lines->starts[hint + 1].pos > pos)
+      low = high = hint + 1;
+  }
+  while(low < high) {
+    mid = low + (high - low) / 2;
+    if(lines->starts[mid].pos <= pos)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+  lines->hint = low;
+
+  *line_number = low + 1;
+  *column_number = mb_pos - (low ? lines->starts[low - 1].mb_pos : 0);
+}
+
+/* Lines in the document, the last one counting even when empty. While
+  an append is being scanned only the scan position is a known offset,
+  so the lines after it are counted without being indexed. */
+long unsigned int parser_document_line_count(struct parser_t *parser)
+{
+  struct scan_t *scan = &parser->tk.scan;
+  long unsigned int line_number, column_number, pos;
+  const char *newline;
+
+  if(!parser->doc.is_appending) {
+    parser_line_and_column(parser, parser->doc.length, parser->doc.mb_length, &line_number, &column_number);
+    return line_number;
+  }
+
+  pos = scan->cursor - scan->skipped;
+  parser_line_and_column(parser, pos, scan->mb_cursor, &line_number, &column_number);
+  while((newline = memchr(parser->doc.data + pos, '\n', parser->doc.length - pos))) {
+    pos = newline + 1 - parser->doc.data;
+    line_number++;
+  }
+  return line_number;
+}
+
+/* The document keeps the encoding it was given first, callers must
+  not append text in another encoding. */
+void parser_set_encoding(struct parser_t *parser, int enc_index)
+{
+  parser->doc.enc_index = enc_index;
+  parser->doc.enc_kind = ht_hooks.encoding_kind(enc_index);
+  return;
+}
+
+static int parser_document_append(struct parser_t *parser, const char *string, unsigned long int length)
+{
+#ifdef DEBUG
+  void *old = parser->doc.data;
+#endif
+
+  long unsigned int capacity = parser->doc.capacity;
+
+  if(parser->doc.length + length + 1 > capacity) {
+    if(capacity < PARSER_DOCUMENT_MIN_CAPACITY)
+      capacity = PARSER_DOCUMENT_MIN_CAPACITY;
+    while(capacity < parser->doc.length + length + 1)
+      capacity *= 2;
+    HT_REALLOC_N(parser->doc.data, char, capacity);
+    DBG_PRINT("parser=%p realloc(parser->doc.data) %p -> %p capacity=%lu", parser, old,
+      parser->doc.data, capacity);
+    parser->doc.capacity = capacity;
+  }
+  memcpy(parser->doc.data + parser->doc.length, string, length);
+  parser->doc.length += length;
+  parser->doc.is_started = 1;
+  parser->doc.data[parser->doc.length] = '\0';
+  return 1;
+}
+
+/* Appends string to the document and tokenizes it, calling f_callback
+  for every token. A caller whose callbacks can unwind out of the scan
+  must call parser_end_append on the way out. */
+void parser_append(struct parser_t *parser, const char *string, long unsigned int length)
+{
+  struct scan_t *scan = &parser->tk.scan;
+
+  parser_document_append(parser, string, length);
+  parser->doc.is_appending = 1;
+
+  tokenizer_borrow_scan_string(&parser->tk, parser->doc.data, parser->doc.length);
+  scan->enc_index = parser->doc.enc_index;
+  scan->enc_kind = parser->doc.enc_kind;
+  tokenizer_scan_all(&parser->tk);
+
+  parser_end_append(parser);
+  if(parser->f_event)
+    parser_flush_text(parser);
+  tokenizer_report_context_overflow(&parser->tk);
+  return;
+}
+
+/* Characters in the document. While an append is scanned, or when its
+  scan was cut short, the bytes past the scan position are counted from
+  there. */
+long unsigned int parser_document_length(const struct parser_t *parser)
+{
+  const struct scan_t *scan = &parser->tk.scan;
+  long unsigned int pos;
+
+  if(!parser->doc.is_appending)
+    return parser->doc.mb_length;
+
+  pos = scan->cursor - scan->skipped;
+  return scan->mb_cursor + position_advance(parser->doc.enc_kind, parser->doc.enc_index,
+    parser->doc.data + pos, parser->doc.length - pos, NULL, NULL);
+}
+
+/* Counts the characters of the last append and records its end for the
+  line index, once. Bytes a cut-short scan did not reach are scanned on
+  the next append. */
+void parser_end_append(struct parser_t *parser)
+{
+  if(!parser->doc.is_appending)
+    return;
+  parser->doc.mb_length = parser_document_length(parser);
+  parser->doc.is_appending = 0;
+  tokenizer_free_scan_string(&parser->tk);
+
+  parser_push_offset(&parser->lines.appends, &parser->lines.appends_count, &parser->lines.appends_capacity,
+    parser->doc.length, parser->doc.mb_length);
+  return;
+}
+
+/* Appends string to the document without tokenizing it, moving the
+  position past it. */
+void parser_append_placeholder(struct parser_t *parser, const char *string, long unsigned int length)
+{
+  struct scan_t *scan = &parser->tk.scan;
+
+  parser_document_append(parser, string, length);
+
+  scan->mb_cursor += position_advance(parser->doc.enc_kind, parser->doc.enc_index,
+    parser->doc.data + scan->cursor, parser->doc.length - scan->cursor, NULL, NULL);
+  scan->cursor = parser->doc.length;
+
+  parser->doc.mb_length = scan->mb_cursor;
+  parser_push_offset(&parser->lines.appends, &parser->lines.appends_count, &parser->lines.appends_capacity,
+    parser->doc.length, parser->doc.mb_length);
+  return;
+}
+
+static const char *parser_context_names[PARSER_CONTEXT_COUNT] = {
+  [PARSER_NONE] = "none",
+  [PARSER_SOLIDUS_OR_TAG_NAME] = "solidus_or_tag_name",
+  [PARSER_TAG_NAME] = "tag_name",
+  [PARSER_TAG] = "tag",
+  [PARSER_ATTRIBUTE_NAME] = "attribute_name",
+  [PARSER_ATTRIBUTE_WHITESPACE_OR_EQUAL] = "after_attribute_name",
+  [PARSER_ATTRIBUTE_WHITESPACE_OR_VALUE] = "after_equal",
+  [PARSER_ATTRIBUTE_QUOTED_VALUE] = "quoted_value",
+  [PARSER_SPACE_AFTER_ATTRIBUTE] = "space_after_attribute",
+  [PARSER_ATTRIBUTE_UNQUOTED_VALUE] = "unquoted_value",
+  [PARSER_TAG_END] = "tag_end",
+  [PARSER_COMMENT] = "comment",
+  [PARSER_CDATA] = "cdata",
+};
+
+static const char *parser_event_type_names[PARSER_EVENT_TYPE_COUNT] = {
+  [PARSER_EVENT_START_TAG] = "start_tag",
+  [PARSER_EVENT_END_TAG] = "end_tag",
+  [PARSER_EVENT_TEXT] = "text",
+  [PARSER_EVENT_COMMENT] = "comment",
+  [PARSER_EVENT_CDATA] = "cdata",
+};
+
+const char *parser_event_type_name(enum parser_event_type type)
+{
+  if((unsigned int)type >= PARSER_EVENT_TYPE_COUNT)
+    return NULL;
+  return parser_event_type_names[type];
+}
+
+const char *parser_context_name(enum parser_context context)
+{
+  if((unsigned int)context >= PARSER_CONTEXT_COUNT)
+    return NULL;
+  return parser_context_names[context];
+}
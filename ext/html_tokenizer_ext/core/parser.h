@@ -0,0 +1,193 @@
+#pragma once
+#include "tokenizer.h"
+
+enum parser_context {
+  PARSER_NONE,
+  PARSER_SOLIDUS_OR_TAG_NAME,
+  PARSER_TAG_NAME,
+  PARSER_TAG,
+  PARSER_ATTRIBUTE_NAME,
+  PARSER_ATTRIBUTE_WHITESPACE_OR_EQUAL,
+  PARSER_ATTRIBUTE_WHITESPACE_OR_VALUE,
+  PARSER_ATTRIBUTE_QUOTED_VALUE,
+  PARSER_SPACE_AFTER_ATTRIBUTE,
+  PARSER_ATTRIBUTE_UNQUOTED_VALUE,
+  PARSER_TAG_END,
+  PARSER_COMMENT,
+  PARSER_CDATA,
+};
+
+#define PARSER_CONTEXT_COUNT (PARSER_CDATA + 1)
+
+enum parser_error {
+  PARSER_ERROR_SOLIDUS_OR_TAG_NAME = 0,
+  PARSER_ERROR_TAG,
+  PARSER_ERROR_TAG_END,
+  PARSER_ERROR_ATTRIBUTE_NAME,
+  PARSER_ERROR_ATTRIBUTE_WHITESPACE_OR_EQUAL,
+  PARSER_ERROR_ATTRIBUTE_VALUE,
+  PARSER_ERROR_SPACE_AFTER_ATTRIBUTE,
+};
+
+#define PARSER_ERROR_COUNT (PARSER_ERROR_SPACE_AFTER_ATTRIBUTE + 1)
+#define PARSER_ERRORS_MIN_CAPACITY 16
+
+enum parser_event_type {
+  PARSER_EVENT_START_TAG = 0,
+  PARSER_EVENT_END_TAG,
+  PARSER_EVENT_TEXT,
+  PARSER_EVENT_COMMENT,
+  PARSER_EVENT_CDATA,
+};
+
+#define PARSER_EVENT_TYPE_COUNT (PARSER_EVENT_CDATA + 1)
+#define PARSER_ATTRIBUTES_MIN_CAPACITY 8
+
+struct parser_document_error_t {
+  enum parser_error error;
+  long unsigned int pos;
+  long unsigned int mb_pos;
+};
+
+#define PARSER_DOCUMENT_MIN_CAPACITY 256
+
+struct parser_document_t {
+  long unsigned int length;
+  long unsigned int capacity;
+  char *data;
+  /* set by the first append, the buffer outlives parser_reset */
+  int is_started;
+
+  int enc_index;
+  enum ht_encoding_kind enc_kind;
+  long unsigned int mb_length;
+  /* between the start of parser_append and parser_end_append, while
+    mb_length and the line index don't cover the new bytes yet */
+  int is_appending;
+};
+
+struct token_reference_t {
+  enum token_type type;
+  long unsigned int start;
+  long unsigned int mb_start;
+  long unsigned int length;
+  long unsigned int mb_length;
+};
+
+/* a point in the document, in bytes and in characters */
+struct parser_offset_t {
+  long unsigned int pos;
+  long unsigned int mb_pos;
+};
+
+#define PARSER_LINES_MIN_CAPACITY 64
+
+/* Where the lines after the first start, found only once a line or
+  column is asked for. Characters are counted from the nearest point
+  whose character offset is known, the end of an append or a token
+  boundary, so a character cut between two appends counts the way the
+  tokens holding it did. */
+struct parser_line_index_t {
+  size_t count;
+  size_t capacity;
+  struct parser_offset_t *starts;
+
+  size_t appends_count;
+  size_t appends_capacity;
+  struct parser_offset_t *appends; // the end of the document after each append
+  size_t next_append;
+
+  struct parser_offset_t indexed; // the document before it is indexed
+  size_t hint; // line of the last lookup
+};
+
+struct parser_tag_t {
+  struct token_reference_t name;
+  int self_closing;
+};
+
+struct parser_attribute_t {
+  struct token_reference_t name;
+  struct token_reference_t value;
+  int is_quoted;
+};
+
+struct parser_rawtext_t {
+  struct token_reference_t text;
+};
+
+struct parser_comment_t {
+  struct token_reference_t text;
+};
+
+struct parser_cdata_t {
+  struct token_reference_t text;
+};
+
+/* A whole tag, text run, comment or cdata section. span covers all of
+  it; for tags, text holds the name, otherwise the content. */
+struct parser_event_t {
+  enum parser_event_type type;
+  struct token_reference_t span;
+  struct token_reference_t text;
+  const struct parser_attribute_t *attributes;
+  size_t attributes_count;
+  int self_closing;
+};
+
+struct parser_t
+{
+  struct tokenizer_t tk;
+
+  struct parser_document_t doc;
+
+  size_t errors_count;
+  size_t errors_capacity;
+  struct parser_document_error_t *errors;
+
+  struct parser_line_index_t lines;
+
+  enum parser_context context;
+  struct parser_tag_t tag;
+  struct parser_attribute_t attribute;
+  struct parser_rawtext_t rawtext;
+  struct parser_comment_t comment;
+  struct parser_cdata_t cdata;
+
+  void *callback_data;
+  void (*f_callback)(struct parser_t *parser, enum token_type type, long unsigned int length, long unsigned int mb_length, void *data);
+  /* the parser sees every token, only those in the mask reach f_callback */
+  uint32_t token_mask;
+
+  /* with f_event set, attributes are collected for the open tag and
+    each completed construct is reported once; text runs wait until
+    the next construct or the end of the append */
+  void (*f_event)(struct parser_t *parser, const struct parser_event_t *event, void *data);
+  struct token_reference_t event_start;
+  struct token_reference_t pending_text;
+  int is_attribute_open;
+  size_t attributes_count;
+  size_t attributes_capacity;
+  struct parser_attribute_t *attributes;
+};
+
+void parser_init(struct parser_t *parser);
+void parser_free_members(struct parser_t *parser);
+void parser_reset(struct parser_t *parser);
+size_t parser_allocated_size(const struct parser_t *parser);
+size_t parser_lines_allocated_size(const struct parser_t *parser);
+void parser_line_and_column(struct parser_t *parser, long unsigned int pos, long unsigned int mb_pos,
+  long unsigned int *line_number, long unsigned int *column_number);
+void parser_set_encoding(struct parser_t *parser, int enc_index);
+void parser_append(struct parser_t *parser, const char *string, long unsigned int length);
+void parser_end_append(struct parser_t *parser);
+void parser_append_placeholder(struct parser_t *parser, const char *string, long unsigned int length);
+long unsigned int parser_document_length(const struct parser_t *parser);
+long unsigned int parser_document_line_count(struct parser_t *parser);
+int parser_in_rawtext(const struct parser_t *parser);
+const char *parser_error_message(enum parser_error error);
+const char *parser_context_name(enum parser_context context);
+const char *parser_event_type_name(enum parser_event_type type);
+
+#define PARSE_AGAIN return 1
+#define PARSE_DONE return 0
@@ -0,0 +1,144 @@
+#include <stdint.h>
+#include <string.h>
+#include "hooks.h"
+#include "position.h"
+
+#define ONES_64 0x0101010101010101ULL
+#define HIGHS_64 0x8080808080808080ULL
+#define HAS_ZERO_BYTE(w) (((w) - ONES_64) & ~(w) & HIGHS_64)
+
+/* same acceptance rules as onigmo's utf-8 table, so invalid and
+  truncated sequences count as one character each like rb_enc_strlen */
+static inline long unsigned int utf8_char_length(const unsigned char *p, const unsigned char *end)
+{
+  unsigned char c = p[0], lo = 0x80, hi = 0xbf;
+  long unsigned int n, i;
+
+  if(c < 0x80)
+    return 1;
+  else if(c >= 0xc2 && c <= 0xdf)
+    n = 2;
+  else if(c >= 0xe0 && c <= 0xef) {
+    n = 3;
+    if(c == 0xe0)
+      lo = 0xa0;
+    else if(c == 0xed)
+      hi = 0x9f;
+  }
+  else if(c >= 0xf0 && c <= 0xf4) {
+    n = 4;
+    if(c == 0xf0)
+      lo = 0x90;
+    else if(c == 0xf4)
+      hi = 0x8f;
+  }
+  else
+    return 1;
+
+  if((long unsigned int)(end - p) < n || p[1] < lo || p[1] > hi)
+    return 1;
+  for(i = 2; i < n; i++) {
+    if(p[i] < 0x80 || p[i] > 0xbf)
+      return 1;
+  }
+  return n;
+}
+
+static long unsigned int utf8_advance(const char *buf, long unsigned int length,
+  long unsigned int *line_number, long unsigned int *column_number)
+{
+  const unsigned char *p = (const unsigned char *)buf, *end = p + length;
+  long unsigned int chars = 0, line = *line_number, column = *column_number;
+  uint64_t w;
+
+  while(p < end) {
+    if(end - p >= 8) {
+      memcpy(&w, p, sizeof(w));
+      if(!(w & HIGHS_64) && !HAS_ZERO_BYTE(w ^ (ONES_64 * '\n'))) {
+        p += 8;
+        chars += 8;
+        column += 8;
+        continue;
+      }
+    }
+    if(*p == '\n') {
+      line += 1;
+      column = 0;
+      p += 1;
+    }
+    else {
+      p += utf8_char_length(p, end);
+      column += 1;
+    }
+    chars += 1;
+  }
+
+  *line_number = line;
+  *column_number = column;
+  return chars;
+}
+
+static long unsigned int utf8_count(const char *buf, long unsigned int length)
+{
+  const unsigned char *p = (const unsigned char *)buf, *end = p + length;
+  long unsigned int chars = 0;
+  uint64_t w;
+
+  while(p < end) {
+    if(end - p >= 8) {
+      memcpy(&w, p, sizeof(w));
+      if(!(w & HIGHS_64)) {
+        p += 8;
+        chars += 8;
+        continue;
+      }
+    }
+    p += utf8_char_length(p, end);
+    chars += 1;
+  }
+  return chars;
+}
+
+static long unsigned int singlebyte_advance(const char *buf, long unsigned int length,
+  long unsigned int *line_number, long unsigned int *column_number)
+{
+  const char *p = buf, *end = buf + length, *nextlf;
+
+  while((nextlf = memchr(p, '\n', end - p))) {
+    *line_number += 1;
+    *column_number = 0;
+    p = nextlf + 1;
+  }
+  *column_number += end - p;
+  return length;
+}
+
+/* Counts the characters in buf and moves line/column past them in
+  a single pass, or only counts when line_number is NULL. Returns the
+  character count. */
+long unsigned int position_advance(enum ht_encoding_kind enc_kind, int enc_index,
+  const char *buf, long unsigned int length,
+  long unsigned int *line_number, long unsigned int *column_number)
+{
+  long unsigned int line = 1, column = 0;
+
+  if(!line_number) {
+    switch(enc_kind) {
+    case HT_ENCODING_UTF8:
+      return utf8_count(buf, length);
+    case HT_ENCODING_SINGLE_BYTE:
+      return length;
+    default:
+      return ht_hooks.advance(enc_index, buf, length, &line, &column);
+    }
+  }
+
+  switch(enc_kind) {
+  case HT_ENCODING_UTF8:
+    return utf8_advance(buf, length, line_number, column_number);
+  case HT_ENCODING_SINGLE_BYTE:
+    return singlebyte_advance(buf, length, line_number, column_number);
+  default:
+    return ht_hooks.advance(enc_index, buf, length, line_number, column_number);
+  }
+}
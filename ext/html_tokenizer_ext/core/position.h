@@ -0,0 +1,6 @@
+#pragma once
+#include "hooks.h"
+
+long unsigned int position_advance(enum ht_encoding_kind enc_kind, int enc_index,
+  const char *buf, long unsigned int length,
+  long unsigned int *line_number, long unsigned int *column_number);
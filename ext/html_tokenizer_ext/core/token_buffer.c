@@ -0,0 +1,73 @@
+#include "debug.h"
+#include "hooks.h"
+#include "token_buffer.h"
+
+void token_buffer_free_members(struct token_buffer_t *buffer)
+{
+  if(buffer->tokens) {
+    DBG_PRINT("buffer=%p ht_free(buffer->tokens) %p", buffer, buffer->tokens);
+    ht_free(buffer->tokens);
+    buffer->tokens = NULL;
+  }
+  buffer->count = 0;
+  buffer->capacity = 0;
+}
+
+static void token_buffer_reserve(struct token_buffer_t *buffer, size_t count)
+{
+  size_t capacity = buffer->capacity ? buffer->capacity : 64;
+
+  while(capacity < buffer->count + count)
+    capacity *= 2;
+  if(capacity != buffer->capacity) {
+    buffer->capacity = capacity;
+    HT_REALLOC_N(buffer->tokens, struct token_entry_t, buffer->capacity);
+    DBG_PRINT("buffer=%p realloc(buffer->tokens) %p capacity=%lu", buffer,
+      buffer->tokens, buffer->capacity);
+  }
+}
+
+void token_buffer_push(struct token_buffer_t *buffer, struct tokenizer_t *tk,
+  enum token_type type, long unsigned int length, long unsigned int mb_length)
+{
+  struct token_entry_t *entry;
+
+  if(buffer->count == buffer->capacity)
+    token_buffer_reserve(buffer, 1);
+
+  entry = &buffer->tokens[buffer->count++];
+  entry->type = type;
+  entry->start = tk->scan.cursor;
+  entry->length = length;
+  entry->mb_start = tk->scan.mb_cursor;
+  entry->mb_length = mb_length;
+  entry->line_number = tk->scan.line_number;
+  entry->column_number = tk->scan.column_number;
+}
+
+void token_buffer_callback(struct tokenizer_t *tk, enum token_type type, long unsigned int length, long unsigned int mb_length, void *data)
+{
+  tk->last_token = type;
+  token_buffer_push((struct token_buffer_t *)data, tk, type, length, mb_length);
+}
+
+/* Appends the tokens of src, which was scanned from line 1 column 0,
+  as if its scan had started at the given position instead. */
+void token_buffer_append_shifted(struct token_buffer_t *buffer, const struct token_buffer_t *src,
+  long unsigned int start, long unsigned int mb_start,
+  long unsigned int line_number, long unsigned int column_number)
+{
+  struct token_entry_t *entry;
+  size_t i;
+
+  token_buffer_reserve(buffer, src->count);
+  for(i = 0; i < src->count; i++) {
+    entry = &buffer->tokens[buffer->count++];
+    *entry = src->tokens[i];
+    entry->start += start;
+    entry->mb_start += mb_start;
+    if(entry->line_number == 1)
+      entry->column_number += column_number;
+    entry->line_number += line_number - 1;
+  }
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include "tokenizer.h"
+
+struct token_entry_t {
+  enum token_type type;
+  long unsigned int start;
+  long unsigned int length;
+  long unsigned int mb_start;
+  long unsigned int mb_length;
+  long unsigned int line_number;
+  long unsigned int column_number;
+};
+
+struct token_buffer_t {
+  size_t count;
+  size_t capacity;
+  struct token_entry_t *tokens;
+};
+
+void token_buffer_free_members(struct token_buffer_t *buffer);
+void token_buffer_push(struct token_buffer_t *buffer, struct tokenizer_t *tk,
+  enum token_type type, long unsigned int length, long unsigned int mb_length);
+void token_buffer_callback(struct tokenizer_t *tk, enum token_type type, long unsigned int length, long unsigned int mb_length, void *data);
+void token_buffer_append_shifted(struct token_buffer_t *buffer, const struct token_buffer_t *src,
+  long unsigned int start, long unsigned int mb_start,
+  long unsigned int line_number, long unsigned int column_number);
@@ -0,0 +1,839 @@
+#include <stdint.h>
+#include <string.h>
+#include "debug.h"
+#include "hooks.h"
+#include "tokenizer.h"
+#include "position.h"
+#include "charclass.h"
+
+void tokenizer_init(struct tokenizer_t *tk)
+{
+  tk->current_context = 0;
+  tk->context[0] = TOKENIZER_HTML;
+  tk->context_overflow = 0;
+
+  tk->scan.string = NULL;
+  tk->scan.is_borrowed = 0;
+  tk->scan.cursor = 0;
+  tk->scan.length = 0;
+  tk->scan.is_partial = 0;
+  tk->scan.rest_is_text = 0;
+  tk->scan.mb_cursor = 0;
+  tk->scan.line_number = 1;
+  tk->scan.column_number = 0;
+  tk->scan.skipped = 0;
+  tk->scan.dropped = 0;
+  tk->scan.count_lines = 1;
+  tk->scan.enc_index = 0;
+  tk->scan.enc_kind = HT_ENCODING_UTF8;
+
+  tk->attribute_value_start = 0;
+  tk->found_attribute = 0;
+  tk->current_tag_length = 0;
+  tk->current_tag_context = TOKENIZER_NONE;
+  tk->is_closing_tag = 0;
+  tk->last_token = TOKEN_NONE;
+  tk->is_scanning_without_gvl = 0;
+  tk->callback_data = NULL;
+  tk->f_callback = NULL;
+  tk->token_mask = TOKEN_MASK_ALL;
+  tk->is_stopped = 0;
+  tk->stop_offset = 0;
+
+  return;
+}
+
+void tokenizer_free_members(struct tokenizer_t *tk)
+{
+  tokenizer_free_scan_string(tk);
+  return;
+}
+
+/* Starts over like tokenizer_init, dropping any stream in progress but
+  keeping the callback. */
+void tokenizer_reset(struct tokenizer_t *tk)
+{
+  void *callback_data = tk->callback_data;
+  void (*f_callback)(struct tokenizer_t *, enum token_type, long unsigned int, long unsigned int, void *) = tk->f_callback;
+
+  tokenizer_free_members(tk);
+  tokenizer_init(tk);
+  tk->callback_data = callback_data;
+  tk->f_callback = f_callback;
+  return;
+}
+
+/* Copies the context stack and tag state of src into dst, leaving
+  dst's scan string, position and callback alone. */
+void tokenizer_copy_state(struct tokenizer_t *dst, const struct tokenizer_t *src)
+{
+  memcpy(dst->context, src->context, sizeof(dst->context));
+  dst->current_context = src->current_context;
+  dst->context_overflow = src->context_overflow;
+  dst->attribute_value_start = src->attribute_value_start;
+  dst->found_attribute = src->found_attribute;
+  dst->is_closing_tag = src->is_closing_tag;
+  dst->last_token = src->last_token;
+  memcpy(dst->current_tag, src->current_tag, sizeof(dst->current_tag));
+  dst->current_tag_length = src->current_tag_length;
+  dst->current_tag_context = src->current_tag_context;
+  return;
+}
+
+/* Reports a context stack overflow left by the last scan through the
+  error hook, first dropping any stream in progress and restarting the
+  stack from html. Callers must be able to take an error from the hook. */
+void tokenizer_report_context_overflow(struct tokenizer_t *tk)
+{
+  if(!tk->context_overflow)
+    return;
+  tokenizer_free_scan_string(tk);
+  tk->context_overflow = 0;
+  tk->current_context = 0;
+  tk->context[0] = TOKENIZER_HTML;
+  ht_hooks.error("tokenizer context stack overflow");
+}
+
+/* Bytes tk holds on the heap besides itself. */
+size_t tokenizer_allocated_size(const struct tokenizer_t *tk)
+{
+  if(!tk->scan.string || tk->scan.is_borrowed)
+    return 0;
+  return tk->scan.length + 1;
+}
+
+static const char *token_type_names[TOKEN_TYPE_COUNT] = {
+  [TOKEN_NONE] = "none",
+  [TOKEN_TEXT] = "text",
+  [TOKEN_WHITESPACE] = "whitespace",
+  [TOKEN_COMMENT_START] = "comment_start",
+  [TOKEN_COMMENT_END] = "comment_end",
+  [TOKEN_TAG_START] = "tag_start",
+  [TOKEN_TAG_NAME] = "tag_name",
+  [TOKEN_TAG_END] = "tag_end",
+  [TOKEN_ATTRIBUTE_NAME] = "attribute_name",
+  [TOKEN_ATTRIBUTE_QUOTED_VALUE_START] = "attribute_quoted_value_start",
+  [TOKEN_ATTRIBUTE_QUOTED_VALUE] = "attribute_quoted_value",
+  [TOKEN_ATTRIBUTE_QUOTED_VALUE_END] = "attribute_quoted_value_end",
+  [TOKEN_ATTRIBUTE_UNQUOTED_VALUE] = "attribute_unquoted_value",
+  [TOKEN_CDATA_START] = "cdata_start",
+  [TOKEN_CDATA_END] = "cdata_end",
+  [TOKEN_SOLIDUS] = "solidus",
+  [TOKEN_EQUAL] = "equal",
+  [TOKEN_MALFORMED] = "malformed",
+};
+
+const char *tokenizer_token_type_name(enum token_type type)
+{
+  if((unsigned int)type >= TOKEN_TYPE_COUNT)
+    return NULL;
+  return token_type_names[type];
+}
+
+static inline char ascii_tolower(char c)
+{
+  return (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+}
+
+/* Counts the bytes of skipped tokens into the position. */
+static void advance_skipped(struct scan_t *scan)
+{
+  if(!scan->skipped)
+    return;
+  scan->mb_cursor += position_advance(scan->enc_kind, scan->enc_index, scan->string + scan->cursor - scan->skipped,
+    scan->skipped, scan->count_lines ? &scan->line_number : NULL, &scan->column_number);
+  scan->skipped = 0;
+}
+
+static void tokenizer_callback(struct tokenizer_t *tk, enum token_type type, long unsigned int length)
+{
+  long unsigned int line_number, column_number, mb_length;
+
+  if(tk->is_stopped) {
+    tk->scan.cursor += length;
+    return;
+  }
+  if(!(tk->token_mask & TOKEN_MASK(type))) {
+    tk->last_token = type;
+    tk->scan.cursor += length;
+    tk->scan.skipped += length;
+    return;
+  }
+
+  advance_skipped(&tk->scan);
+  line_number = tk->scan.line_number;
+  column_number = tk->scan.column_number;
+  mb_length = position_advance(tk->scan.enc_kind, tk->scan.enc_index, tk->scan.string + tk->scan.cursor,
+    length, tk->scan.count_lines ? &line_number : NULL, &column_number);
+
+  if(tk->f_callback)
+    tk->f_callback(tk, type, length, mb_length, tk->callback_data);
+  tk->scan.cursor += length;
+  tk->scan.mb_cursor += mb_length;
+  tk->scan.line_number = line_number;
+  tk->scan.column_number = column_number;
+  if(tk->is_stopped)
+    tk->stop_offset = tk->scan.dropped + tk->scan.cursor;
+}
+
+static inline int eos(struct scan_t *scan)
+{
+  return scan->cursor >= scan->length;
+}
+
+static inline long unsigned int length_remaining(struct scan_t *scan)
+{
+  return scan->length - scan->cursor;
+}
+
+/* Whether the token at the cursor reaches the end of a partial scan,
+  in which case it may continue in the next chunk of the stream. */
+static inline int reaches_end(struct scan_t *scan, long unsigned int length)
+{
+  return scan->is_partial && scan->cursor + length >= scan->length;
+}
+
+/* A run of text that reaches the end of a partial scan is held back
+  until the next chunk shows where it ends. Runs too long to hold are
+  emitted up to the last character boundary, keeping at least `keep`
+  bytes for a close marker that may be cut. Returns the length to emit
+  now, 0 to wait for more input. */
+static long unsigned int partial_run_length(struct tokenizer_t *tk, long unsigned int length, long unsigned int keep)
+{
+  const unsigned char *run = (const unsigned char *)&tk->scan.string[tk->scan.cursor];
+  long unsigned int i;
+
+  if(length < TOKENIZER_MAX_HELD_RUN || tk->scan.enc_kind == HT_ENCODING_MULTIBYTE)
+    return 0;
+
+  length -= keep;
+  if(tk->scan.enc_kind == HT_ENCODING_UTF8) {
+    /* anything but a continuation byte starts a character */
+    for(i = 0; i < 4 && (run[length - 1 - i] & 0xc0) == 0x80; i++) {}
+    if(i < 4)
+      length -= i + 1;
+  }
+  return length;
+}
+
+/* Whether a partial scan ends inside what may still become marker. */
+static inline int is_cut_marker(struct scan_t *scan, const char *marker, long unsigned int marker_length)
+{
+  long unsigned int remaining = length_remaining(scan);
+
+  return scan->is_partial && remaining < marker_length &&
+    !strncasecmp((const char *)&scan->string[scan->cursor], marker, remaining);
+}
+
+/* Pushing past the end of the stack flags the overflow and leaves no
+  context to scan in, which ends the scan; the host reports the error
+  once it is back from scanning, possibly without the GVL. */
+static inline void push_context(struct tokenizer_t *tk, enum tokenizer_context ctx)
+{
+  if(tk->current_context + 1 >= TOKENIZER_MAX_CONTEXT_DEPTH) {
+    tk->context_overflow = 1;
+    tk->context[tk->current_context] = TOKENIZER_NONE;
+    return;
+  }
+  tk->context[++tk->current_context] = ctx;
+}
+
+static inline void pop_context(struct tokenizer_t *tk)
+{
+  tk->context[tk->current_context--] = TOKENIZER_NONE;
+}
+
+static int is_text(struct scan_t *scan, long unsigned int *length)
+{
+  *length = charclass_find_char(&scan->string[scan->cursor], length_remaining(scan), '<');
+  return *length != 0;
+}
+
+static inline int is_comment_start(struct scan_t *scan)
+{
+  return (length_remaining(scan) >= 4) &&
+    !strncmp((const char *)&scan->string[scan->cursor], "<!--", 4);
+}
+
+static inline int is_doctype(struct scan_t *scan)
+{
+  return (length_remaining(scan) >= 9) &&
+    !strncasecmp((const char *)&scan->string[scan->cursor], "<!DOCTYPE", 9);
+}
+
+static inline int is_cdata_start(struct scan_t *scan)
+{
+  return (length_remaining(scan) >= 9) &&
+    !strncasecmp((const char *)&scan->string[scan->cursor], "<![CDATA[", 9);
+}
+
+static inline int is_char(struct scan_t *scan, const char c)
+{
+  return (length_remaining(scan) >= 1) && (scan->string[scan->cursor] == c);
+}
+
+static inline int is_alnum(const char c)
+{
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9');
+}
+
+static int is_tag_start(struct scan_t *scan, long unsigned int *length,
+  int *closing_tag, const char **tag_name, long unsigned int *tag_name_length)
+{
+  long unsigned int i, start;
+
+  if(scan->string[scan->cursor] != '<')
+    return 0;
+
+  *length = 1;
+
+  if(scan->cursor + 1 < scan->length && scan->string[scan->cursor + 1] == '/') {
+    *closing_tag = 1;
+    (*length)++;
+  } else {
+    *closing_tag = 0;
+  }
+
+  *tag_name = &scan->string[scan->cursor + (*length)];
+  start = *length;
+  for(i = scan->cursor + (*length);i < scan->length; i++, (*length)++) {
+    if(!is_alnum(scan->string[i]) && scan->string[i] != ':')
+      break;
+  }
+
+  *tag_name_length = *length - start;
+  return 1;
+}
+
+static int is_tag_name(struct scan_t *scan, const char **tag_name, unsigned long int *tag_name_length)
+{
+  *tag_name = &scan->string[scan->cursor];
+  *tag_name_length = charclass_find_tag_name_end(*tag_name, length_remaining(scan));
+  return *tag_name_length != 0;
+}
+
+static int is_whitespace(struct scan_t *scan, unsigned long int *length)
+{
+  *length = charclass_skip_whitespace(&scan->string[scan->cursor], length_remaining(scan));
+  return *length != 0;
+}
+
+static int is_attribute_name(struct scan_t *scan, unsigned long int *length)
+{
+  *length = charclass_skip_attribute_name(&scan->string[scan->cursor], length_remaining(scan));
+  return *length != 0;
+}
+
+static int is_unquoted_value(struct scan_t *scan, unsigned long int *length)
+{
+  *length = charclass_find_unquoted_value_end(&scan->string[scan->cursor], length_remaining(scan));
+  return *length != 0;
+}
+
+static int is_attribute_string(struct scan_t *scan, unsigned long int *length, const char attribute_value_start)
+{
+  *length = charclass_find_char(&scan->string[scan->cursor], length_remaining(scan), attribute_value_start);
+  return *length != 0;
+}
+
+static int is_comment_end(struct scan_t *scan, unsigned long int *length, const char **end)
+{
+  *length = charclass_find_close_marker(&scan->string[scan->cursor], length_remaining(scan), '-');
+  if(*length < length_remaining(scan))
+    *end = &scan->string[scan->cursor + *length];
+  return *length != 0;
+}
+
+static int is_cdata_end(struct scan_t *scan, unsigned long int *length, const char **end)
+{
+  *length = charclass_find_close_marker(&scan->string[scan->cursor], length_remaining(scan), ']');
+  if(*length < length_remaining(scan))
+    *end = &scan->string[scan->cursor + *length];
+  return *length != 0;
+}
+
+static int scan_html(struct tokenizer_t *tk)
+{
+  long unsigned int length = 0;
+
+  if(is_char(&tk->scan, '<')) {
+    push_context(tk, TOKENIZER_OPEN_TAG);
+    return 1;
+  }
+  else if(is_text(&tk->scan, &length)) {
+    if(reaches_end(&tk->scan, length) && !(length = partial_run_length(tk, length, 0)))
+      return 0;
+    tokenizer_callback(tk, TOKEN_TEXT, length);
+    return 1;
+  }
+  return 0;
+}
+
+static int scan_open_tag(struct tokenizer_t *tk)
+{
+  unsigned long int length = 0;
+
+  if(is_cut_marker(&tk->scan, "<!--", 4) || is_cut_marker(&tk->scan, "<!DOCTYPE", 9) ||
+      is_cut_marker(&tk->scan, "<![CDATA[", 9))
+    return 0;
+
+  if(is_comment_start(&tk->scan)) {
+    tokenizer_callback(tk, TOKEN_COMMENT_START, 4);
+    pop_context(tk); // back to html
+    push_context(tk, TOKENIZER_COMMENT);
+    return 1;
+  }
+  else if(is_doctype(&tk->scan)) {
+    tokenizer_callback(tk, TOKEN_TAG_START, 1);
+    tokenizer_callback(tk, TOKEN_TAG_NAME, 8);
+    push_context(tk, TOKENIZER_TAG_NAME);
+    return 1;
+  }
+  else if(is_cdata_start(&tk->scan)) {
+    tokenizer_callback(tk, TOKEN_CDATA_START, 9);
+    pop_context(tk); // back to html
+    push_context(tk, TOKENIZER_CDATA);
+    return 1;
+  }
+  else if(is_char(&tk->scan, '<')) {
+    tokenizer_callback(tk, TOKEN_TAG_START, 1);
+    push_context(tk, TOKENIZER_SOLIDUS_OR_TAG_NAME);
+    return 1;
+  }
+  else if(is_whitespace(&tk->scan, &length)) {
+    if(reaches_end(&tk->scan, length) && !(length = partial_run_length(tk, length, 0)))
+      return 0;
+    tokenizer_callback(tk, TOKEN_WHITESPACE, length);
+    return 1;
+  }
+  else if(is_attribute_name(&tk->scan, &length)) {
+    if(reaches_end(&tk->scan, length) && !(length = partial_run_length(tk, length, 0)))
+      return 0;
+    tokenizer_callback(tk, TOKEN_ATTRIBUTE_NAME, length);
+    push_context(tk, TOKENIZER_ATTRIBUTE_NAME);
+    return 1;
+  }
+  else if(is_char(&tk->scan, '\'') || is_char(&tk->scan, '"')) {
+    push_context(tk, TOKENIZER_ATTRIBUTE_VALUE);
+    return 1;
+  }
+  else if(is_char(&tk->scan, '=')) {
+    tokenizer_callback(tk, TOKEN_EQUAL, 1);
+    push_context(tk, TOKENIZER_ATTRIBUTE_VALUE);
+    return 1;
+  }
+  else if(is_char(&tk->scan, '/')) {
+    tokenizer_callback(tk, TOKEN_SOLIDUS, 1);
+    return 1;
+  }
+  else if(is_char(&tk->scan, '>')) {
+    tokenizer_callback(tk, TOKEN_TAG_END, 1);
+    pop_context(tk); // pop tag context
+
+    if(!tk->is_closing_tag && tk->current_tag_context != TOKENIZER_NONE)
+      push_context(tk, tk->current_tag_context);
+    return 1;
+  }
+  return 0;
+}
+
+/* The context the content of an opening tag is scanned in, or
+  TOKENIZER_NONE for tags whose content is plain html. */
+static enum tokenizer_context tag_content_context(const char *name, long unsigned int length)
+{
+  switch(length) {
+  case 3:
+    if(!memcmp(name, "xmp", 3))
+      return TOKENIZER_RAWTEXT;
+    break;
+  case 5:
+    if(!memcmp(name, "title", 5))
+      return TOKENIZER_RCDATA;
+    else if(!memcmp(name, "style", 5))
+      return TOKENIZER_RAWTEXT;
+    break;
+  case 6:
+    if(!memcmp(name, "script", 6))
+      return TOKENIZER_SCRIPT_DATA;
+    else if(!memcmp(name, "iframe", 6))
+      return TOKENIZER_RAWTEXT;
+    break;
+  case 7:
+    if(!memcmp(name, "noembed", 7) || !memcmp(name, "listing", 7))
+      return TOKENIZER_RAWTEXT;
+    break;
+  case 8:
+    if(!memcmp(name, "textarea", 8))
+      return TOKENIZER_RCDATA;
+    else if(!memcmp(name, "noframes", 8))
+      return TOKENIZER_RAWTEXT;
+    break;
+  case 9:
+    if(!memcmp(name, "plaintext", 9))
+      return TOKENIZER_PLAINTEXT;
+    break;
+  }
+  return TOKENIZER_NONE;
+}
+
+static int scan_solidus_or_tag_name(struct tokenizer_t *tk)
+{
+  tk->current_tag_length = 0;
+  tk->current_tag_context = TOKENIZER_NONE;
+
+  if(is_char(&tk->scan, '/')) {
+    tk->is_closing_tag = 1;
+    tokenizer_callback(tk, TOKEN_SOLIDUS, 1);
+  }
+  else {
+    tk->is_closing_tag = 0;
+  }
+
+  pop_context(tk);
+  push_context(tk, TOKENIZER_TAG_NAME);
+  return 1;
+}
+
+static int scan_tag_name(struct tokenizer_t *tk)
+{
+  unsigned long int i, tag_name_length = 0;
+  const char *tag_name = NULL;
+
+  if(is_tag_name(&tk->scan, &tag_name, &tag_name_length)) {
+    if(reaches_end(&tk->scan, tag_name_length) && !(tag_name_length = partial_run_length(tk, tag_name_length, 0)))
+      return 0;
+    /* only the lowercased start of long names is kept, no long
+      name changes the content context */
+    for(i = 0; i < tag_name_length && tk->current_tag_length + i < TOKENIZER_TAG_NAME_CAPACITY; i++)
+      tk->current_tag[tk->current_tag_length + i] = ascii_tolower(tag_name[i]);
+    tk->current_tag_length += tag_name_length;
+
+    tokenizer_callback(tk, TOKEN_TAG_NAME, tag_name_length);
+    return 1;
+  }
+
+  tk->current_tag_context = tag_content_context(tk->current_tag, tk->current_tag_length);
+  pop_context(tk); // back to open_tag
+  return 1;
+}
+
+static int scan_attribute_name(struct tokenizer_t *tk)
+{
+  unsigned long int length = 0;
+
+  if(is_attribute_name(&tk->scan, &length)) {
+    if(reaches_end(&tk->scan, length) && !(length = partial_run_length(tk, length, 0)))
+      return 0;
+    tokenizer_callback(tk, TOKEN_ATTRIBUTE_NAME, length);
+    return 1;
+  }
+
+  pop_context(tk); // back to open tag
+  return 1;
+}
+
+static int scan_attribute_value(struct tokenizer_t *tk)
+{
+  unsigned long int length = 0;
+
+  if(is_whitespace(&tk->scan, &length)) {
+    if(reaches_end(&tk->scan, length) && !(length = partial_run_length(tk, length, 0)))
+      return 0;
+    tokenizer_callback(tk, TOKEN_WHITESPACE, length);
+    return 1;
+  }
+  else if(is_char(&tk->scan, '\'') || is_char(&tk->scan, '"')) {
+    tk->attribute_value_start = tk->scan.string[tk->scan.cursor];
+    tokenizer_callback(tk, TOKEN_ATTRIBUTE_QUOTED_VALUE_START, 1);
+    pop_context(tk); // back to open tag
+    push_context(tk, TOKENIZER_ATTRIBUTE_QUOTED);
+    return 1;
+  }
+
+  pop_context(tk); // back to open tag
+  push_context(tk, TOKENIZER_ATTRIBUTE_UNQUOTED);
+  return 1;
+}
+
+static int scan_attribute_unquoted(struct tokenizer_t *tk)
+{
+  unsigned long int length = 0;
+
+  if(is_unquoted_value(&tk->scan, &length)) {
+    if(reaches_end(&tk->scan, length) && !(length = partial_run_length(tk, length, 0)))
+      return 0;
+    tokenizer_callback(tk, TOKEN_ATTRIBUTE_UNQUOTED_VALUE, length);
+    return 1;
+  }
+
+  pop_context(tk); // back to open tag
+  return 1;
+}
+
+static int scan_attribute_quoted(struct tokenizer_t *tk)
+{
+  unsigned long int length = 0;
+
+  if(is_char(&tk->scan, tk->attribute_value_start)) {
+    tokenizer_callback(tk, TOKEN_ATTRIBUTE_QUOTED_VALUE_END, 1);
+    pop_context(tk); // back to open tag
+    return 1;
+  }
+  else if(is_attribute_string(&tk->scan, &length, tk->attribute_value_start)) {
+    if(reaches_end(&tk->scan, length) && !(length = partial_run_length(tk, length, 0)))
+      return 0;
+    tokenizer_callback(tk, TOKEN_ATTRIBUTE_QUOTED_VALUE, length);
+    return 1;
+  }
+  return 0;
+}
+
+static int scan_plaintext(struct tokenizer_t *tk)
+{
+  long unsigned int length = length_remaining(&tk->scan);
+
+  if(tk->scan.is_partial && !(length = partial_run_length(tk, length, 0)))
+    return 0;
+  tokenizer_callback(tk, TOKEN_TEXT, length);
+  return 1;
+}
+
+static int scan_comment(struct tokenizer_t *tk)
+{
+  unsigned long int length = 0;
+  const char *comment_end = NULL;
+
+  if(tk->scan.rest_is_text)
+    return scan_plaintext(tk);
+
+  if(is_comment_end(&tk->scan, &length, &comment_end)) {
+    if(!comment_end && reaches_end(&tk->scan, length) && !(length = partial_run_length(tk, length, 3)))
+      return 0;
+    tokenizer_callback(tk, TOKEN_TEXT, length);
+    if(comment_end) {
+      tokenizer_callback(tk, TOKEN_COMMENT_END, 3);
+      pop_context(tk); // back to document
+    }
+    return 1;
+  }
+  else {
+    tk->scan.rest_is_text = 1;
+    return scan_plaintext(tk);
+  }
+  return 0;
+}
+
+static int scan_cdata(struct tokenizer_t *tk)
+{
+  unsigned long int length = 0;
+  const char *cdata_end = NULL;
+
+  if(tk->scan.rest_is_text)
+    return scan_plaintext(tk);
+
+  if(is_cdata_end(&tk->scan, &length, &cdata_end)) {
+    if(!cdata_end && reaches_end(&tk->scan, length) && !(length = partial_run_length(tk, length, 3)))
+      return 0;
+    tokenizer_callback(tk, TOKEN_TEXT, length);
+    if(cdata_end)
+      tokenizer_callback(tk, TOKEN_CDATA_END, 3);
+    return 1;
+  }
+  else {
+    tk->scan.rest_is_text = 1;
+    return scan_plaintext(tk);
+  }
+  return 0;
+}
+
+static int scan_rawtext(struct tokenizer_t *tk)
+{
+  long unsigned int length = 0, tag_name_length = 0;
+  const char *tag_name = NULL;
+  int closing_tag = 0;
+
+  if(is_tag_start(&tk->scan, &length, &closing_tag, &tag_name, &tag_name_length)) {
+    /* a cut closing tag may still turn out to close this one */
+    if(reaches_end(&tk->scan, length) && !(length = partial_run_length(tk, length, 0)))
+      return 0;
+    if(closing_tag && tag_name_length <= tk->current_tag_length &&
+        !strncasecmp((const char *)tag_name, tk->current_tag, tag_name_length)) {
+      pop_context(tk);
+    } else {
+      tokenizer_callback(tk, TOKEN_TEXT, length);
+    }
+    return 1;
+  }
+  else if(is_text(&tk->scan, &length)) {
+    if(reaches_end(&tk->scan, length) && !(length = partial_run_length(tk, length, 0)))
+      return 0;
+    tokenizer_callback(tk, TOKEN_TEXT, length);
+    return 1;
+  }
+  else {
+    tokenizer_callback(tk, TOKEN_TEXT, length_remaining(&tk->scan));
+    return 1;
+  }
+  return 0;
+}
+
+static int scan_once(struct tokenizer_t *tk)
+{
+  switch(tk->context[tk->current_context]) {
+  case TOKENIZER_NONE:
+    break;
+  case TOKENIZER_HTML:
+    return scan_html(tk);
+  case TOKENIZER_OPEN_TAG:
+    return scan_open_tag(tk);
+  case TOKENIZER_SOLIDUS_OR_TAG_NAME:
+    return scan_solidus_or_tag_name(tk);
+  case TOKENIZER_TAG_NAME:
+    return scan_tag_name(tk);
+  case TOKENIZER_COMMENT:
+    return scan_comment(tk);
+  case TOKENIZER_CDATA:
+    return scan_cdata(tk);
+  case TOKENIZER_RCDATA:
+  case TOKENIZER_RAWTEXT:
+  case TOKENIZER_SCRIPT_DATA:
+    /* we don't consume character references so all
+      of these states are effectively the same */
+    return scan_rawtext(tk);
+  case TOKENIZER_PLAINTEXT:
+    return scan_plaintext(tk);
+  case TOKENIZER_ATTRIBUTE_NAME:
+    return scan_attribute_name(tk);
+  case TOKENIZER_ATTRIBUTE_VALUE:
+    return scan_attribute_value(tk);
+  case TOKENIZER_ATTRIBUTE_UNQUOTED:
+    return scan_attribute_unquoted(tk);
+  case TOKENIZER_ATTRIBUTE_QUOTED:
+    return scan_attribute_quoted(tk);
+  }
+  return 0;
+}
+
+/* Scans one step of the string, which calls back with a few tokens
+  at most, and returns 0 once the string is done. */
+int tokenizer_scan_step(struct tokenizer_t *tk)
+{
+  if(!eos(&tk->scan) && scan_once(tk))
+    return 1;
+  if(!eos(&tk->scan) && !tk->scan.is_partial) {
+    tokenizer_callback(tk, TOKEN_MALFORMED, length_remaining(&tk->scan));
+  }
+  advance_skipped(&tk->scan);
+  return 0;
+}
+
+/* Scans until the end of the string or until f_callback stops it. A
+  step that yields more than one token finishes after a stop, without
+  calling back or counting the position, and the next scan starts
+  over from html since the rest of this input is never seen. */
+void tokenizer_scan_all(struct tokenizer_t *tk)
+{
+  tk->is_stopped = 0;
+  while(tokenizer_scan_step(tk)) {
+    if(tk->is_stopped) {
+      tk->current_context = 0;
+      tk->context[0] = TOKENIZER_HTML;
+      return;
+    }
+  }
+  return;
+}
+
+/* Scans the next chunk of a stream. Input that can't be tokenized yet,
+  the start of a token that may continue in the next chunk, is kept
+  and scanned again in front of it; everything before it is dropped.
+  Positions count from the start of the stream, which ends with the
+  is_final chunk or when f_callback stops the scan. */
+void tokenizer_scan_chunk(struct tokenizer_t *tk, const char *chunk, long unsigned int length, int is_final)
+{
+  struct scan_t *scan = &tk->scan;
+  long unsigned int pending = 0;
+
+  if(scan->is_partial) {
+    pending = scan->length - scan->cursor;
+    scan->dropped += scan->cursor;
+  }
+  else {
+    tokenizer_free_scan_string(tk);
+    scan->mb_cursor = 0;
+    scan->line_number = 1;
+    scan->column_number = 0;
+    scan->dropped = 0;
+  }
+
+  if(pending && scan->cursor)
+    memmove(scan->string, scan->string + scan->cursor, pending);
+  HT_REALLOC_N(scan->string, char, pending + length + 1);
+  DBG_PRINT("tk=%p realloc(tk->scan.string) %p pending=%lu length=%lu", tk, scan->string,
+    pending, length);
+  memcpy(scan->string + pending, chunk, length);
+  scan->string[pending + length] = 0;
+  scan->cursor = 0;
+  scan->length = pending + length;
+  scan->is_partial = !is_final;
+
+  tokenizer_scan_all(tk);
+
+  if(is_final || tk->is_stopped)
+    tokenizer_free_scan_string(tk);
+  return;
+}
+
+void tokenizer_set_encoding(struct tokenizer_t *tk, int enc_index)
+{
+  tk->scan.enc_index = enc_index;
+  tk->scan.enc_kind = ht_hooks.encoding_kind(enc_index);
+}
+
+void tokenizer_set_scan_string(struct tokenizer_t *tk, const char *string, long unsigned int length)
+{
+#ifdef DEBUG
+  void *old = tk->scan.string;
+#endif
+
+  if(tk->scan.is_borrowed)
+    tokenizer_free_scan_string(tk);
+  HT_REALLOC_N(tk->scan.string, char, string ? length + 1 : 0);
+  DBG_PRINT("tk=%p realloc(tk->scan.string) %p -> %p length=%lu", tk, old,
+    tk->scan.string, length + 1);
+  if(string && length > 0) {
+    strncpy(tk->scan.string, string, length);
+    tk->scan.string[length] = 0;
+  }
+  tk->scan.length = length;
+  tk->scan.dropped = 0;
+  tk->scan.is_partial = 0;
+  tk->scan.rest_is_text = 0;
+  return;
+}
+
+/* Scans the caller's buffer in place, the caller must keep it alive
+  and unchanged until tokenizer_free_scan_string. */
+void tokenizer_borrow_scan_string(struct tokenizer_t *tk, const char *string, long unsigned int length)
+{
+  tokenizer_free_scan_string(tk);
+  tk->scan.string = (char *)string;
+  tk->scan.is_borrowed = 1;
+  tk->scan.length = length;
+  tk->scan.dropped = 0;
+  return;
+}
+
+void tokenizer_free_scan_string(struct tokenizer_t *tk)
+{
+  if(tk->scan.string && !tk->scan.is_borrowed) {
+    DBG_PRINT("tk=%p ht_free(tk->scan.string) %p", tk, tk->scan.string);
+    ht_free(tk->scan.string);
+  }
+  tk->scan.string = NULL;
+  tk->scan.is_borrowed = 0;
+  tk->scan.length = 0;
+  tk->scan.is_partial = 0;
+  tk->scan.rest_is_text = 0;
+  return;
+}
@@ -0,0 +1,123 @@
+#pragma once
+#include <stdint.h>
+#include "hooks.h"
+
+enum tokenizer_context {
+  TOKENIZER_NONE = 0,
+  TOKENIZER_HTML,
+  TOKENIZER_OPEN_TAG,
+  TOKENIZER_SOLIDUS_OR_TAG_NAME,
+  TOKENIZER_TAG_NAME,
+  TOKENIZER_CDATA,
+  TOKENIZER_RCDATA, // title, textarea
+  TOKENIZER_RAWTEXT, // style, xmp, iframe, noembed, noframes
+  TOKENIZER_SCRIPT_DATA, // script
+  TOKENIZER_PLAINTEXT, // plaintext
+  TOKENIZER_COMMENT,
+  TOKENIZER_ATTRIBUTE_NAME,
+  TOKENIZER_ATTRIBUTE_VALUE,
+  TOKENIZER_ATTRIBUTE_UNQUOTED,
+  TOKENIZER_ATTRIBUTE_QUOTED,
+};
+
+enum token_type {
+  TOKEN_NONE = 0,
+  TOKEN_TEXT,
+  TOKEN_WHITESPACE,
+  TOKEN_COMMENT_START,
+  TOKEN_COMMENT_END,
+  TOKEN_TAG_START,
+  TOKEN_TAG_NAME,
+  TOKEN_TAG_END,
+  TOKEN_ATTRIBUTE_NAME,
+  TOKEN_ATTRIBUTE_QUOTED_VALUE_START,
+  TOKEN_ATTRIBUTE_QUOTED_VALUE,
+  TOKEN_ATTRIBUTE_QUOTED_VALUE_END,
+  TOKEN_ATTRIBUTE_UNQUOTED_VALUE,
+  TOKEN_CDATA_START,
+  TOKEN_CDATA_END,
+  TOKEN_SOLIDUS,
+  TOKEN_EQUAL,
+  TOKEN_MALFORMED,
+};
+
+#define TOKEN_TYPE_COUNT (TOKEN_MALFORMED + 1)
+
+/* bit sets of token types, for picking the tokens a callback sees */
+#define TOKEN_MASK(type) (UINT32_C(1) << (type))
+#define TOKEN_MASK_ALL (TOKEN_MASK(TOKEN_TYPE_COUNT) - 1)
+
+struct scan_t {
+  char *string;
+  int is_borrowed;
+  long unsigned int cursor;
+  long unsigned int length;
+  int is_partial; // more of the stream follows the string
+  int rest_is_text; // a close marker right at the cursor ended tokenizing
+
+  int enc_index;
+  enum ht_encoding_kind enc_kind;
+  long unsigned int mb_cursor;
+  long unsigned int line_number;
+  long unsigned int column_number;
+  long unsigned int skipped; // bytes before the cursor not yet counted in the position
+  long unsigned int dropped; // bytes of the stream dropped before the string
+  int count_lines; // off when the owner works out lines on its own
+};
+
+/* longest run of text a stream holds back waiting for its end */
+#define TOKENIZER_MAX_HELD_RUN (64 * 1024)
+
+/* long enough for every tag name that changes the content context */
+#define TOKENIZER_TAG_NAME_CAPACITY 16
+
+/* contexts nest at most three deep (html, an open tag and a name or
+  attribute inside it), the rest is headroom */
+#define TOKENIZER_MAX_CONTEXT_DEPTH 8
+
+struct tokenizer_t
+{
+  enum tokenizer_context context[TOKENIZER_MAX_CONTEXT_DEPTH];
+  uint32_t current_context;
+  int context_overflow;
+
+  void *callback_data;
+  void (*f_callback)(struct tokenizer_t *tk, enum token_type type, long unsigned int length, long unsigned int mb_length, void *data);
+  /* tokens outside the mask are scanned but not passed to f_callback,
+    the position is only brought up to date at the next one that is */
+  uint32_t token_mask;
+
+  /* set from f_callback to end the scan after the current token; the
+    position stays at its end, stop_offset is its end in bytes */
+  int is_stopped;
+  long unsigned int stop_offset;
+
+  char attribute_value_start;
+  int found_attribute;
+
+  char current_tag[TOKENIZER_TAG_NAME_CAPACITY];
+  long unsigned int current_tag_length;
+  enum tokenizer_context current_tag_context;
+
+  int is_closing_tag;
+  enum token_type last_token;
+  int is_scanning_without_gvl;
+
+  struct scan_t scan;
+};
+
+
+void tokenizer_init(struct tokenizer_t *tk);
+void tokenizer_free_members(struct tokenizer_t *tk);
+void tokenizer_reset(struct tokenizer_t *tk);
+void tokenizer_copy_state(struct tokenizer_t *dst, const struct tokenizer_t *src);
+void tokenizer_report_context_overflow(struct tokenizer_t *tk);
+size_t tokenizer_allocated_size(const struct tokenizer_t *tk);
+void tokenizer_set_encoding(struct tokenizer_t *tk, int enc_index);
+void tokenizer_set_scan_string(struct tokenizer_t *tk, const char *string, long unsigned int length);
+void tokenizer_borrow_scan_string(struct tokenizer_t *tk, const char *string, long unsigned int length);
+void tokenizer_free_scan_string(struct tokenizer_t *tk);
+int tokenizer_scan_step(struct tokenizer_t *tk);
+void tokenizer_scan_all(struct tokenizer_t *tk);
+void tokenizer_scan_chunk(struct tokenizer_t *tk, const char *chunk, long unsigned int length, int is_final);
+const char *tokenizer_token_type_name(enum token_type type);
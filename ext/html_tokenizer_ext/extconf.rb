@@ -1,12 +1,61 @@
 require 'mkmf'
 
+# Build profiles:
+#
+#   release (default)  -O3, with link-time optimization when the
+#                      compiler supports it
+#   DEBUG=1            -O0 with DBG_PRINT tracing
+#
+# HTML_TOKENIZER_MARCH=native (or any -march value) tunes the release
+# build for one CPU. HTML_TOKENIZER_PGO=generate:DIR builds with
+# profiling that writes to DIR, HTML_TOKENIZER_PGO=use:DIR rebuilds from
+# the profile there; `rake compile:pgo` trains on the benchmark corpus
+# and rebuilds.
+
 $CXXFLAGS += " -std=c++11 "
-$CXXFLAGS += " -g -O1 -ggdb "
-$CFLAGS += " -g -O1 -ggdb "
+
+def add_flags(flags, ldflags: false)
+  return false unless try_cflags(flags) && (!ldflags || try_ldflags(flags))
+  $CFLAGS += " #{flags} "
+  $CXXFLAGS += " #{flags} "
+  $LDFLAGS += " #{flags} " if ldflags
+  true
+end
 
 if ENV['DEBUG']
-  $CXXFLAGS += "  -DDEBUG "
-  $CFLAGS += "  -DDEBUG "
+  add_flags("-O0 -ggdb -DDEBUG")
+else
+  add_flags("-O3 -g")
+  add_flags("-flto=auto", ldflags: true) || add_flags("-flto", ldflags: true)
+  if (march = ENV['HTML_TOKENIZER_MARCH'])
+    add_flags("-march=#{march}") or abort "-march=#{march} is not supported by #{RbConfig::CONFIG['CC']}"
+  end
 end
 
+case ENV['HTML_TOKENIZER_PGO']
+when nil, ""
+when /\Agenerate:(.+)\z/
+  add_flags("-fprofile-generate=#{$1}", ldflags: true) or
+    abort "profile-guided optimization is not supported by #{RbConfig::CONFIG['CC']}"
+  # the parallel scan updates counters from several threads
+  add_flags("-fprofile-update=atomic")
+when /\Ause:(.+)\z/
+  # gcc warns about every source without a profile, the probe included
+  (add_flags("-fprofile-use=#{$1} -Wno-missing-profile") || add_flags("-fprofile-use=#{$1}")) or
+    abort "profile-guided optimization is not supported by #{RbConfig::CONFIG['CC']}"
+  add_flags("-fprofile-correction")
+else
+  abort "HTML_TOKENIZER_PGO must be generate:DIR or use:DIR"
+end
+
+have_header('sys/mman.h')
+have_func('madvise', 'sys/mman.h')
+have_func('rb_enc_interned_str', 'ruby.h')
+
+# the scanner and parser live in core/, which builds on its own
+# without ruby, see core/Makefile
+$VPATH << "$(srcdir)/core"
+$INCFLAGS << " -I$(srcdir)/core"
+$srcs = Dir.glob("#{$srcdir}/{,core/}*.c").map { |path| File.basename(path) }
+
 create_makefile('html_tokenizer_ext')
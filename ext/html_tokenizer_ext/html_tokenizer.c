@@ -1,12 +1,110 @@
 #include <ruby.h>
-#include "tokenizer.h"
-#include "parser.h"
+#include <ruby/encoding.h>
+#include "html_tokenizer.h"
 
 static VALUE mHtmlTokenizer = Qnil;
 
+/* The core library allocates with the Ruby allocator so its memory
+  counts towards GC pressure, and leaves encodings other than utf-8
+  and single byte ones to onigmo. */
+
+static void *ruby_hooks_realloc(void *ptr, size_t size)
+{
+  return ruby_xrealloc(ptr, size);
+}
+
+static void ruby_hooks_free(void *ptr)
+{
+  ruby_xfree(ptr);
+}
+
+static enum ht_encoding_kind ruby_hooks_encoding_kind(int enc_index)
+{
+  rb_encoding *enc;
+
+  if(enc_index == rb_utf8_encindex())
+    return HT_ENCODING_UTF8;
+  enc = rb_enc_from_index(enc_index);
+  if(rb_enc_asciicompat(enc) && rb_enc_mbmaxlen(enc) == 1)
+    return HT_ENCODING_SINGLE_BYTE;
+  return HT_ENCODING_MULTIBYTE;
+}
+
+static long unsigned int asciicompat_advance(rb_encoding *enc, const char *buf, long unsigned int length,
+  long unsigned int *line_number, long unsigned int *column_number)
+{
+  const char *p = buf, *end = buf + length;
+  long unsigned int chars = 0;
+
+  while(p < end) {
+    if(*p == '\n') {
+      *line_number += 1;
+      *column_number = 0;
+      p += 1;
+    }
+    else {
+      p += rb_enc_mbclen(p, end, enc);
+      *column_number += 1;
+    }
+    chars += 1;
+  }
+  return chars;
+}
+
+static long unsigned int generic_advance(rb_encoding *enc, const char *buf, long unsigned int length,
+  long unsigned int *line_number, long unsigned int *column_number)
+{
+  long unsigned int i;
+  const char *p, *nextlf;
+
+  for(i = 0; i < length;) {
+    p = &buf[i];
+    nextlf = memchr(p, '\n', length - i);
+    if(nextlf) {
+      *column_number = 0;
+      *line_number += 1;
+      i += (nextlf - p) + 1;
+    }
+    else {
+      *column_number += rb_enc_strlen(p, p + length - i, enc);
+      break;
+    }
+  }
+
+  return rb_enc_strlen(buf, buf + length, enc);
+}
+
+static long unsigned int ruby_hooks_advance(int enc_index, const char *buf, long unsigned int length,
+  long unsigned int *line_number, long unsigned int *column_number)
+{
+  rb_encoding *enc = rb_enc_from_index(enc_index);
+
+  if(!rb_enc_asciicompat(enc))
+    return generic_advance(enc, buf, length, line_number, column_number);
+  else
+    return asciicompat_advance(enc, buf, length, line_number, column_number);
+}
+
+static void ruby_hooks_error(const char *message)
+{
+  rb_raise(rb_eArgError, "%s", message);
+}
+
+static const struct ht_hooks_t ruby_hooks = {
+  ruby_hooks_realloc,
+  ruby_hooks_free,
+  ruby_hooks_encoding_kind,
+  ruby_hooks_advance,
+  ruby_hooks_error,
+};
+
 void Init_html_tokenizer_ext()
 {
+  ht_init(&ruby_hooks);
+
   mHtmlTokenizer = rb_define_module("HtmlTokenizer");
+  Init_html_tokenizer_token_buffer(mHtmlTokenizer);
+  Init_html_tokenizer_token_iterator(mHtmlTokenizer);
   Init_html_tokenizer_tokenizer(mHtmlTokenizer);
   Init_html_tokenizer_parser(mHtmlTokenizer);
 }
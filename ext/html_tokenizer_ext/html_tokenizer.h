@@ -1,7 +1,25 @@
-#pragma once
-
-#ifdef DEBUG
-#define DBG_PRINT(msg, arg...) printf("%s:%u: " msg "\n", __FUNCTION__, __LINE__, arg);
-#else
-#define DBG_PRINT(msg, arg...) ((void)0);
-#endif
+#pragma once
+#include "debug.h"
+#include "hooks.h"
+#include "tokenizer.h"
+#include "token_buffer.h"
+#include "parser.h"
+
+void Init_html_tokenizer_token_buffer(VALUE mHtmlTokenizer);
+void Init_html_tokenizer_token_iterator(VALUE mHtmlTokenizer);
+void Init_html_tokenizer_tokenizer(VALUE mHtmlTokenizer);
+void Init_html_tokenizer_parser(VALUE mHtmlTokenizer);
+
+VALUE token_type_to_symbol(enum token_type type);
+uint32_t token_mask_option(VALUE options);
+VALUE token_buffer_new(struct token_buffer_t **buffer);
+VALUE token_iterator_new(struct tokenizer_t *tk, VALUE source, uint32_t token_mask);
+
+extern const rb_data_type_t ht_tokenizer_data_type;
+#define Tokenizer_Get_Struct(obj, sval) TypedData_Get_Struct(obj, struct tokenizer_t, &ht_tokenizer_data_type, sval)
+
+extern const rb_data_type_t ht_token_buffer_data_type;
+#define TokenBuffer_Get_Struct(obj, sval) TypedData_Get_Struct(obj, struct token_buffer_t, &ht_token_buffer_data_type, sval)
+
+extern const rb_data_type_t ht_parser_data_type;
+#define Parser_Get_Struct(obj, sval) TypedData_Get_Struct(obj, struct parser_t, &ht_parser_data_type, sval)
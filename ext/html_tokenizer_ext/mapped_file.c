@@ -0,0 +1,120 @@
+#include <ruby.h>
+#include <ruby/encoding.h>
+#include <ruby/thread.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+#include "mapped_file.h"
+
+#ifndef O_CLOEXEC
+#define O_CLOEXEC 0
+#endif
+
+/*
+  Regular files are mapped whole and scanned in place, with a
+  sequential access hint so the kernel reads ahead and drops pages
+  behind the scan. Anything that can't be mapped, pipes, character
+  devices or empty files, is left to mapped_file_read.
+
+  Like any mapping, a file truncated by another process while it is
+  being scanned faults on the missing pages.
+*/
+
+/* The encoding: option of tokenize_file and parse_file, utf-8 unless
+  given. */
+int mapped_file_encoding_option(VALUE options)
+{
+  VALUE encoding = Qundef;
+  ID keywords[1];
+
+  if(!NIL_P(options)) {
+    keywords[0] = rb_intern("encoding");
+    rb_get_kwargs(options, keywords, 0, 1, &encoding);
+  }
+  return encoding == Qundef ? rb_utf8_encindex() : rb_enc_to_index(rb_to_encoding(encoding));
+}
+
+void mapped_file_open(struct mapped_file_t *file, VALUE path)
+{
+#ifdef HAVE_SYS_MMAN_H
+  struct stat st;
+  void *data;
+#endif
+
+  FilePathValue(path);
+  file->data = NULL;
+  file->length = 0;
+  file->is_mapped = 0;
+
+  file->fd = open(StringValueCStr(path), O_RDONLY | O_CLOEXEC);
+  if(file->fd < 0)
+    rb_sys_fail_str(path);
+
+#ifdef HAVE_SYS_MMAN_H
+  if(fstat(file->fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+    data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, file->fd, 0);
+    if(data != MAP_FAILED) {
+      file->data = data;
+      file->length = st.st_size;
+      file->is_mapped = 1;
+#ifdef HAVE_MADVISE
+      madvise(data, file->length, MADV_SEQUENTIAL);
+#endif
+    }
+  }
+#endif
+}
+
+struct mapped_file_read_t {
+  int fd;
+  char *buf;
+  long unsigned int size;
+  ssize_t result;
+  int error;
+};
+
+static void *mapped_file_read_without_gvl(void *data)
+{
+  struct mapped_file_read_t *read_args = data;
+
+  read_args->result = read(read_args->fd, read_args->buf, read_args->size);
+  read_args->error = errno;
+  return NULL;
+}
+
+/* Reads up to size bytes of an unmapped file into buf, without the
+  GVL since a pipe may block. Returns 0 at the end of the file. */
+long unsigned int mapped_file_read(struct mapped_file_t *file, char *buf, long unsigned int size)
+{
+  struct mapped_file_read_t read_args = { file->fd, buf, size, 0, 0 };
+
+  do {
+    rb_thread_call_without_gvl(mapped_file_read_without_gvl, &read_args, RUBY_UBF_IO, NULL);
+    if(read_args.result < 0 && read_args.error == EINTR)
+      rb_thread_check_ints();
+  } while(read_args.result < 0 && read_args.error == EINTR);
+
+  if(read_args.result < 0) {
+    errno = read_args.error;
+    rb_sys_fail("read");
+  }
+  return read_args.result;
+}
+
+void mapped_file_close(struct mapped_file_t *file)
+{
+#ifdef HAVE_SYS_MMAN_H
+  if(file->is_mapped)
+    munmap(file->data, file->length);
+#endif
+  file->data = NULL;
+  file->length = 0;
+  file->is_mapped = 0;
+  if(file->fd >= 0)
+    close(file->fd);
+  file->fd = -1;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+struct mapped_file_t {
+  int fd;
+  char *data;
+  long unsigned int length;
+  int is_mapped;
+};
+
+int mapped_file_encoding_option(VALUE options);
+void mapped_file_open(struct mapped_file_t *file, VALUE path);
+long unsigned int mapped_file_read(struct mapped_file_t *file, char *buf, long unsigned int size);
+void mapped_file_close(struct mapped_file_t *file);
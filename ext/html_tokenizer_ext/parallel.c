@@ -0,0 +1,216 @@
+#include <ruby.h>
+#include <ruby/thread.h>
+#include "html_tokenizer.h"
+#include "parallel.h"
+
+/*
+  Large inputs are cut into chunks right before a '<' that starts a
+  tag or closing tag. Chunk 0 is scanned from the caller's tokenizer
+  state and every other chunk from a fresh tokenizer, all at once on
+  separate threads.
+
+  A chunk that ends in the html context with nothing pending ends at
+  a token boundary of the sequential scan, and the tag start that
+  opens the next chunk resets all the tag state a fresh tokenizer
+  would differ in, so the next chunk's tokens are exactly the ones the
+  sequential scan would have produced. When a chunk ends anywhere else,
+  in a comment, script or attribute value, the rest of the input is
+  rescanned on one thread from the start of that chunk.
+*/
+
+#define PARALLEL_MIN_CHUNK_LENGTH (128 * 1024)
+#define PARALLEL_MAX_CHUNKS 64
+
+struct parallel_chunk_t {
+  struct tokenizer_t tk;
+  struct token_buffer_t tokens;
+  long unsigned int start;
+  long unsigned int length;
+};
+
+struct parallel_scan_t {
+  struct tokenizer_t *tk;
+  struct token_buffer_t *buffer;
+  struct parallel_chunk_t *chunks;
+  long unsigned int capacity;
+  long unsigned int count;
+  VALUE threads;
+};
+
+static int is_chunk_start(const char *string, long unsigned int length, long unsigned int i)
+{
+  char c;
+
+  if(i + 1 >= length)
+    return 0;
+  c = string[i + 1];
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '/';
+}
+
+static long unsigned int find_chunk_start(const char *string, long unsigned int length, long unsigned int from)
+{
+  const char *lt;
+
+  while(from < length && (lt = memchr(&string[from], '<', length - from))) {
+    from = lt - string;
+    if(is_chunk_start(string, length, from))
+      return from;
+    from += 1;
+  }
+  return length;
+}
+
+/* Resets the chunk to scan length bytes of tk's scan string from start,
+  either from tk's state or from a fresh one. */
+static void chunk_reset(struct parallel_chunk_t *chunk, struct tokenizer_t *tk, int from_tk_state,
+  long unsigned int start, long unsigned int length)
+{
+  tokenizer_free_members(&chunk->tk);
+  tokenizer_init(&chunk->tk);
+  if(from_tk_state)
+    tokenizer_copy_state(&chunk->tk, tk);
+  chunk->tk.f_callback = token_buffer_callback;
+  chunk->tk.callback_data = &chunk->tokens;
+  chunk->tk.scan.enc_index = tk->scan.enc_index;
+  chunk->tk.scan.enc_kind = tk->scan.enc_kind;
+  tokenizer_borrow_scan_string(&chunk->tk, tk->scan.string + start, length);
+  chunk->tokens.count = 0;
+  chunk->start = start;
+  chunk->length = length;
+}
+
+static int chunk_ends_in_html(struct parallel_chunk_t *chunk)
+{
+  return chunk->tk.current_context == 0 &&
+    chunk->tk.context[0] == TOKENIZER_HTML &&
+    chunk->tk.last_token != TOKEN_MALFORMED;
+}
+
+static void *chunk_scan_without_gvl(void *data)
+{
+  tokenizer_scan_all(&((struct parallel_chunk_t *)data)->tk);
+  return NULL;
+}
+
+static VALUE chunk_thread(void *data)
+{
+  rb_thread_call_without_gvl(chunk_scan_without_gvl, data, NULL, NULL);
+  return Qnil;
+}
+
+static VALUE parallel_scan_body(VALUE arg)
+{
+  struct parallel_scan_t *ps = (struct parallel_scan_t *)arg;
+  struct tokenizer_t *tk = ps->tk;
+  struct parallel_chunk_t *chunk = NULL;
+  long unsigned int i, mb_cursor = 0, line_number = 1, column_number = 0;
+
+  for(i = 0; i < ps->count; i++)
+    chunk_reset(&ps->chunks[i], tk, i == 0, ps->chunks[i].start, ps->chunks[i].length);
+  for(i = 1; i < ps->count; i++)
+    rb_ary_push(ps->threads, rb_thread_create(chunk_thread, &ps->chunks[i]));
+  rb_thread_call_without_gvl(chunk_scan_without_gvl, &ps->chunks[0], NULL, NULL);
+  for(i = 0; i < (long unsigned int)RARRAY_LEN(ps->threads); i++)
+    rb_funcall(rb_ary_entry(ps->threads, i), rb_intern("join"), 0);
+
+  for(i = 0; i < ps->count; i++) {
+    chunk = &ps->chunks[i];
+    if(i + 1 < ps->count && !chunk_ends_in_html(chunk)) {
+      chunk_reset(chunk, tk, i == 0, chunk->start, tk->scan.length - chunk->start);
+      rb_thread_call_without_gvl(chunk_scan_without_gvl, chunk, NULL, NULL);
+      ps->count = i + 1;
+    }
+
+    token_buffer_append_shifted(ps->buffer, &chunk->tokens,
+      chunk->start, mb_cursor, line_number, column_number);
+    mb_cursor += chunk->tk.scan.mb_cursor;
+    if(chunk->tk.scan.line_number > 1)
+      column_number = chunk->tk.scan.column_number;
+    else
+      column_number += chunk->tk.scan.column_number;
+    line_number += chunk->tk.scan.line_number - 1;
+  }
+
+  tokenizer_copy_state(tk, &chunk->tk);
+  tk->scan.cursor = tk->scan.length;
+  tk->scan.mb_cursor = mb_cursor;
+  tk->scan.line_number = line_number;
+  tk->scan.column_number = column_number;
+
+  return Qnil;
+}
+
+static VALUE chunk_thread_join(VALUE thread)
+{
+  return rb_funcall(thread, rb_intern("join"), 0);
+}
+
+/* The workers borrow tk's scan string, so nothing may unwind past here
+  while one still runs. An interrupt raised by join is held and the
+  join retried until the worker is dead, then re-raised once the
+  chunks are freed. */
+static VALUE parallel_scan_ensure(VALUE arg)
+{
+  struct parallel_scan_t *ps = (struct parallel_scan_t *)arg;
+  VALUE thread;
+  long unsigned int i;
+  int state, pending_state = 0;
+
+  for(i = 0; i < (long unsigned int)RARRAY_LEN(ps->threads); i++) {
+    thread = rb_ary_entry(ps->threads, i);
+    do {
+      rb_protect(chunk_thread_join, thread, &state);
+      if(state)
+        pending_state = state;
+    } while(state && RTEST(rb_funcall(thread, rb_intern("alive?"), 0)));
+  }
+  for(i = 0; i < ps->capacity; i++) {
+    tokenizer_free_members(&ps->chunks[i].tk);
+    token_buffer_free_members(&ps->chunks[i].tokens);
+  }
+  xfree(ps->chunks);
+
+  if(pending_state)
+    rb_jump_tag(pending_state);
+  return Qnil;
+}
+
+/* Scans tk's whole scan string into buffer on up to `threads` threads,
+  producing the same tokens and final state as tokenizer_scan_all.
+  Returns 0 without scanning when the input is too short to split. */
+int parallel_scan_all(struct tokenizer_t *tk, struct token_buffer_t *buffer, int threads)
+{
+  struct parallel_scan_t ps;
+  long unsigned int count, i, start, next;
+
+  count = tk->scan.length / PARALLEL_MIN_CHUNK_LENGTH;
+  if(threads < 1)
+    threads = 1;
+  if(count > (long unsigned int)threads)
+    count = threads;
+  if(count > PARALLEL_MAX_CHUNKS)
+    count = PARALLEL_MAX_CHUNKS;
+  if(count < 2)
+    return 0;
+
+  ps.tk = tk;
+  ps.buffer = buffer;
+  ps.chunks = ZALLOC_N(struct parallel_chunk_t, count);
+  ps.capacity = count;
+  ps.threads = rb_ary_new_capa(count - 1);
+
+  for(i = 0, start = 0; i < count && start < tk->scan.length; i++, start = next) {
+    next = i + 1 < count ?
+      find_chunk_start(tk->scan.string, tk->scan.length, (tk->scan.length / count) * (i + 1)) :
+      tk->scan.length;
+    if(next <= start)
+      next = find_chunk_start(tk->scan.string, tk->scan.length, start + 1);
+    ps.chunks[i].start = start;
+    ps.chunks[i].length = next - start;
+  }
+  ps.count = i;
+
+  rb_ensure(parallel_scan_body, (VALUE)&ps, parallel_scan_ensure, (VALUE)&ps);
+  RB_GC_GUARD(ps.threads);
+  return 1;
+}
@@ -0,0 +1,5 @@
+#pragma once
+#include "tokenizer.h"
+#include "token_buffer.h"
+
+int parallel_scan_all(struct tokenizer_t *tk, struct token_buffer_t *buffer, int threads);
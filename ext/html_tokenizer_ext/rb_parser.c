@@ -0,0 +1,707 @@
+#include <ruby.h>
+#include <ruby/encoding.h>
+#include "html_tokenizer.h"
+#include "mapped_file.h"
+
+/* read size for files that can't be mapped */
+#define PARSER_FILE_CHUNK_LENGTH (64 * 1024)
+
+static VALUE cParser = Qnil;
+
+/* references whose text the accessors return */
+enum parser_string {
+  PARSER_STRING_TAG_NAME,
+  PARSER_STRING_ATTRIBUTE_NAME,
+  PARSER_STRING_ATTRIBUTE_VALUE,
+  PARSER_STRING_COMMENT_TEXT,
+  PARSER_STRING_CDATA_TEXT,
+  PARSER_STRING_RAWTEXT_TEXT,
+  PARSER_STRING_COUNT,
+};
+
+/* The frozen string last returned for a reference. The document only
+  ever grows, so the same start and length always hold the same text. */
+struct parser_string_cache_t {
+  long unsigned int start;
+  long unsigned int length;
+  VALUE string;
+};
+
+/* The parser behind a Parser object. The core parser comes first so
+  Parser_Get_Struct can hand it out directly. */
+struct rb_parser_t {
+  struct parser_t parser;
+  struct parser_string_cache_t strings[PARSER_STRING_COUNT];
+  int intern_names;
+};
+
+#define RbParser_Get_Struct(obj, sval) TypedData_Get_Struct(obj, struct rb_parser_t, &ht_parser_data_type, sval)
+
+static void parser_mark(void *ptr)
+{
+  struct rb_parser_t *rb_parser = ptr;
+  int i;
+
+  for(i = 0; i < PARSER_STRING_COUNT; i++)
+    rb_gc_mark(rb_parser->strings[i].string);
+}
+
+static void parser_free(void *ptr)
+{
+  struct rb_parser_t *rb_parser = ptr;
+
+  if(rb_parser) {
+    parser_free_members(&rb_parser->parser);
+    DBG_PRINT("parser=%p xfree(parser)", rb_parser);
+    xfree(rb_parser);
+  }
+}
+
+static size_t parser_memsize(const void *ptr)
+{
+  const struct rb_parser_t *rb_parser = ptr;
+  return ptr ? sizeof(struct rb_parser_t) + parser_allocated_size(&rb_parser->parser) : 0;
+}
+
+const rb_data_type_t ht_parser_data_type = {
+  "ht_parser_data_type",
+  { parser_mark, parser_free, parser_memsize, },
+#if defined(RUBY_TYPED_FREE_IMMEDIATELY)
+  NULL, NULL, RUBY_TYPED_FREE_IMMEDIATELY
+#endif
+};
+
+static void parser_clear_strings(struct rb_parser_t *rb_parser)
+{
+  int i;
+
+  for(i = 0; i < PARSER_STRING_COUNT; i++) {
+    rb_parser->strings[i].start = 0;
+    rb_parser->strings[i].length = 0;
+    rb_parser->strings[i].string = Qnil;
+  }
+}
+
+static VALUE parser_allocate(VALUE klass)
+{
+  VALUE obj;
+  struct rb_parser_t *rb_parser = NULL;
+
+  obj = TypedData_Make_Struct(klass, struct rb_parser_t, &ht_parser_data_type, rb_parser);
+  DBG_PRINT("parser=%p allocate", rb_parser);
+  parser_clear_strings(rb_parser);
+
+  return obj;
+}
+
+static void parser_yield_token(struct parser_t *parser, enum token_type type, long unsigned int length, long unsigned int mb_length, void *data)
+{
+  struct scan_t *scan = &parser->tk.scan;
+  long unsigned int line_number, column_number;
+
+  parser_line_and_column(parser, scan->cursor, scan->mb_cursor, &line_number, &column_number);
+  rb_yield_values(5, token_type_to_symbol(type),
+    ULONG2NUM(scan->mb_cursor), ULONG2NUM(scan->mb_cursor + mb_length),
+    ULONG2NUM(line_number), ULONG2NUM(column_number));
+}
+
+static void parser_buffer_token(struct parser_t *parser, enum token_type type, long unsigned int length, long unsigned int mb_length, void *data)
+{
+  struct token_buffer_t *buffer = (struct token_buffer_t *)data;
+  struct token_entry_t *entry;
+
+  token_buffer_push(buffer, &parser->tk, type, length, mb_length);
+  entry = &buffer->tokens[buffer->count - 1];
+  parser_line_and_column(parser, entry->start, entry->mb_start, &entry->line_number, &entry->column_number);
+}
+
+/* With intern_names: true, tag and attribute names are returned as
+  interned strings, shared by every parser. */
+static VALUE parser_initialize_method(int argc, VALUE *argv, VALUE self)
+{
+  struct rb_parser_t *rb_parser = NULL;
+  VALUE options, intern_names = Qundef;
+  ID keywords[1];
+
+  rb_scan_args(argc, argv, "0:", &options);
+  if(!NIL_P(options)) {
+    keywords[0] = rb_intern("intern_names");
+    rb_get_kwargs(options, keywords, 0, 1, &intern_names);
+  }
+
+  RbParser_Get_Struct(self, rb_parser);
+  DBG_PRINT("parser=%p initialize", rb_parser);
+
+  parser_free_members(&rb_parser->parser);
+  parser_init(&rb_parser->parser);
+  parser_clear_strings(rb_parser);
+  rb_parser->intern_names = intern_names != Qundef && RTEST(intern_names);
+
+  return Qnil;
+}
+
+/* Clears the document and parsing state for the next document, keeping
+  the buffers allocated for this one and the options. */
+static VALUE parser_reset_method(VALUE self)
+{
+  struct rb_parser_t *rb_parser = NULL;
+
+  RbParser_Get_Struct(self, rb_parser);
+  parser_reset(&rb_parser->parser);
+  parser_clear_strings(rb_parser);
+
+  return self;
+}
+
+/* Checks that enc_index matches the document and picks where the
+  tokens of the next append go. The callback is set on every call, a
+  previous call may have raised with its own still in place. */
+static void parser_prepare_append(struct parser_t *parser, int enc_index, struct token_buffer_t *token_buffer,
+  uint32_t token_mask)
+{
+  if(!parser->doc.is_started) {
+    parser_set_encoding(parser, enc_index);
+  }
+  else if(parser->doc.enc_index != enc_index) {
+    rb_raise(rb_eArgError, "cannot append %s string to %s document",
+      rb_enc_name(rb_enc_from_index(enc_index)), rb_enc_name(rb_enc_from_index(parser->doc.enc_index)));
+  }
+
+  if(token_buffer) {
+    parser->f_callback = parser_buffer_token;
+    parser->callback_data = token_buffer;
+  }
+  else {
+    parser->f_callback = rb_block_given_p() ? parser_yield_token : NULL;
+    parser->callback_data = NULL;
+  }
+  parser->token_mask = token_mask;
+  parser->f_event = NULL;
+}
+
+struct parser_append_args_t {
+  struct parser_t *parser;
+  const char *string;
+  long unsigned int length;
+};
+
+static VALUE parser_append_body(VALUE arg)
+{
+  struct parser_append_args_t *args = (struct parser_append_args_t *)arg;
+  parser_append(args->parser, args->string, args->length);
+  return Qnil;
+}
+
+static VALUE parser_append_ensure(VALUE arg)
+{
+  struct parser_t *parser = ((struct parser_append_args_t *)arg)->parser;
+
+  parser_end_append(parser);
+  parser->f_callback = NULL;
+  parser->f_event = NULL;
+  parser->callback_data = NULL;
+  return Qnil;
+}
+
+/* Appends like parser_append, but a block that breaks or raises out of
+  the scan still leaves the document length and line index covering
+  the whole append. */
+static void parser_append_yielding(struct parser_t *parser, const char *string, long unsigned int length)
+{
+  struct parser_append_args_t args = { parser, string, length };
+  rb_ensure(parser_append_body, (VALUE)&args, parser_append_ensure, (VALUE)&args);
+}
+
+static VALUE parser_append_data(VALUE self, VALUE source, int is_placeholder, struct token_buffer_t *token_buffer,
+  uint32_t token_mask)
+{
+  struct parser_t *parser = NULL;
+  char *string = NULL;
+
+  if(NIL_P(source))
+    return Qnil;
+
+  Check_Type(source, T_STRING);
+  Parser_Get_Struct(self, parser);
+
+  string = StringValueCStr(source);
+  parser_prepare_append(parser, rb_enc_get_index(source), token_buffer, token_mask);
+
+  if(is_placeholder)
+    parser_append_placeholder(parser, string, strlen(string));
+  else
+    parser_append_yielding(parser, string, strlen(string));
+
+  parser->f_callback = NULL;
+  parser->callback_data = NULL;
+
+  return Qtrue;
+}
+
+/* With only: or except:, the block sees just those token types; the
+  parser itself still follows every token. */
+static VALUE parser_parse_method(int argc, VALUE *argv, VALUE self)
+{
+  VALUE source, options;
+  uint32_t token_mask;
+
+  rb_scan_args(argc, argv, "1:", &source, &options);
+  token_mask = token_mask_option(options);
+  return parser_append_data(self, source, 0, NULL, token_mask);
+}
+
+static VALUE parser_append_placeholder_method(VALUE self, VALUE source)
+{
+  return parser_append_data(self, source, 1, NULL, TOKEN_MASK_ALL);
+}
+
+static VALUE interned_str(const char *ptr, long length, rb_encoding *enc)
+{
+#ifdef HAVE_RB_ENC_INTERNED_STR
+  return rb_enc_interned_str(ptr, length, enc);
+#else
+  return rb_funcall(rb_enc_str_new(ptr, length, enc), rb_intern("-@"), 0);
+#endif
+}
+
+static VALUE parser_event_symbols[PARSER_EVENT_TYPE_COUNT];
+
+static VALUE event_string(struct rb_parser_t *rb_parser, const struct token_reference_t *ref, int is_name)
+{
+  struct parser_t *parser = &rb_parser->parser;
+  rb_encoding *enc = rb_enc_from_index(parser->doc.enc_index);
+
+  if(ref->type == TOKEN_NONE)
+    return rb_enc_str_new("", 0, enc);
+  if(is_name && rb_parser->intern_names)
+    return interned_str(parser->doc.data + ref->start, ref->length, enc);
+  return rb_enc_str_new(parser->doc.data + ref->start, ref->length, enc);
+}
+
+static void push_span(VALUE list, const struct token_reference_t *ref)
+{
+  rb_ary_push(list, ref->type == TOKEN_NONE ? Qnil : ULONG2NUM(ref->mb_start));
+  rb_ary_push(list, ref->type == TOKEN_NONE ? Qnil : ULONG2NUM(ref->mb_start + ref->mb_length));
+}
+
+static void parser_yield_event(struct parser_t *parser, const struct parser_event_t *event, void *data)
+{
+  struct rb_parser_t *rb_parser = (struct rb_parser_t *)data;
+  VALUE type = parser_event_symbols[event->type];
+  VALUE start = ULONG2NUM(event->span.mb_start);
+  VALUE stop = ULONG2NUM(event->span.mb_start + event->span.mb_length);
+  VALUE attributes, attribute;
+  size_t i;
+
+  if(event->type != PARSER_EVENT_START_TAG && event->type != PARSER_EVENT_END_TAG) {
+    rb_yield_values(4, type, start, stop, event_string(rb_parser, &event->text, 0));
+    return;
+  }
+
+  attributes = rb_ary_new_capa(event->attributes_count);
+  for(i = 0; i < event->attributes_count; i++) {
+    attribute = rb_ary_new_capa(5);
+    push_span(attribute, &event->attributes[i].name);
+    push_span(attribute, &event->attributes[i].value);
+    rb_ary_push(attribute, event->attributes[i].is_quoted ? Qtrue : Qfalse);
+    rb_ary_push(attributes, attribute);
+  }
+  rb_yield_values(6, type, start, stop, event_string(rb_parser, &event->text, 1), attributes,
+    event->self_closing ? Qtrue : Qfalse);
+}
+
+/* Parses source like #parse but yields whole constructs instead of
+  tokens: start and end tags with their name, attribute spans and
+  self-closing flag, text runs, comments and cdata sections. */
+static VALUE parser_parse_events_method(VALUE self, VALUE source)
+{
+  struct rb_parser_t *rb_parser = NULL;
+  struct parser_t *parser;
+  char *string = NULL;
+
+  if(NIL_P(source))
+    return Qnil;
+
+  Check_Type(source, T_STRING);
+  rb_need_block();
+  RbParser_Get_Struct(self, rb_parser);
+  parser = &rb_parser->parser;
+
+  string = StringValueCStr(source);
+  parser_prepare_append(parser, rb_enc_get_index(source), NULL, TOKEN_MASK_ALL);
+  parser->f_callback = NULL;
+  parser->f_event = parser_yield_event;
+  parser->callback_data = rb_parser;
+
+  parser_append_yielding(parser, string, strlen(string));
+
+  return Qtrue;
+}
+
+static VALUE parser_parse_tokens_method(VALUE self, VALUE source)
+{
+  struct token_buffer_t *buffer = NULL;
+  VALUE tokens;
+
+  if(NIL_P(source))
+    return Qnil;
+
+  tokens = token_buffer_new(&buffer);
+  parser_append_data(self, source, 0, buffer, TOKEN_MASK_ALL);
+  return tokens;
+}
+
+struct parser_file_scan_t {
+  struct parser_t *parser;
+  struct mapped_file_t file;
+};
+
+/* The document keeps its own copy of the file, so a mapped file is
+  only read once; anything else is read whole before parsing so the
+  tokens don't depend on where the reads end. */
+static VALUE parser_scan_file(VALUE arg)
+{
+  struct parser_file_scan_t *fs = (struct parser_file_scan_t *)arg;
+  long unsigned int length;
+  VALUE source;
+
+  if(fs->file.is_mapped) {
+    parser_append(fs->parser, fs->file.data, fs->file.length);
+  }
+  else {
+    source = rb_str_buf_new(PARSER_FILE_CHUNK_LENGTH);
+    do {
+      rb_str_modify_expand(source, PARSER_FILE_CHUNK_LENGTH);
+      length = mapped_file_read(&fs->file, RSTRING_PTR(source) + RSTRING_LEN(source), PARSER_FILE_CHUNK_LENGTH);
+      rb_str_set_len(source, RSTRING_LEN(source) + length);
+    } while(length);
+    parser_append(fs->parser, RSTRING_PTR(source), RSTRING_LEN(source));
+    RB_GC_GUARD(source);
+  }
+  return Qnil;
+}
+
+static VALUE parser_scan_file_ensure(VALUE arg)
+{
+  struct parser_file_scan_t *fs = (struct parser_file_scan_t *)arg;
+
+  parser_end_append(fs->parser);
+  fs->parser->f_callback = NULL;
+  fs->parser->callback_data = NULL;
+  mapped_file_close(&fs->file);
+  return Qnil;
+}
+
+static VALUE parser_parse_file_method(int argc, VALUE *argv, VALUE self)
+{
+  struct parser_file_scan_t fs;
+  VALUE path, options;
+  int enc_index;
+
+  rb_scan_args(argc, argv, "1:", &path, &options);
+  enc_index = mapped_file_encoding_option(options);
+  Parser_Get_Struct(self, fs.parser);
+
+  parser_prepare_append(fs.parser, enc_index, NULL, TOKEN_MASK_ALL);
+  mapped_file_open(&fs.file, path);
+  rb_ensure(parser_scan_file, (VALUE)&fs, parser_scan_file_ensure, (VALUE)&fs);
+
+  return Qtrue;
+}
+
+static VALUE parser_document_method(VALUE self)
+{
+  struct parser_t *parser = NULL;
+  rb_encoding *enc;
+  Parser_Get_Struct(self, parser);
+  if(!parser->doc.is_started)
+    return Qnil;
+  enc = rb_enc_from_index(parser->doc.enc_index);
+  return rb_enc_str_new(parser->doc.data, parser->doc.length, enc);
+}
+
+/* Characters in the document, counted as it is appended. */
+static VALUE parser_document_length_method(VALUE self)
+{
+  struct parser_t *parser = NULL;
+  Parser_Get_Struct(self, parser);
+  return ULONG2NUM(parser_document_length(parser));
+}
+
+static VALUE parser_document_bytesize_method(VALUE self)
+{
+  struct parser_t *parser = NULL;
+  Parser_Get_Struct(self, parser);
+  return ULONG2NUM(parser->doc.length);
+}
+
+/* Lines in the document, the last one counting even when empty, or 0
+  before anything was appended. */
+static VALUE parser_document_line_count_method(VALUE self)
+{
+  struct parser_t *parser = NULL;
+  Parser_Get_Struct(self, parser);
+  if(!parser->doc.is_started)
+    return INT2FIX(0);
+  return ULONG2NUM(parser_document_line_count(parser));
+}
+
+/* every value Parser#context returns, exposed as Parser::CONTEXTS */
+static VALUE parser_contexts = Qnil;
+static VALUE parser_context_symbols[PARSER_CONTEXT_COUNT];
+static VALUE rawtext_symbol = Qnil;
+
+static void init_parser_context_symbols(void)
+{
+  int i;
+
+  for(i = 0; i < PARSER_CONTEXT_COUNT; i++)
+    parser_context_symbols[i] = ID2SYM(rb_intern(parser_context_name(i)));
+  rawtext_symbol = ID2SYM(rb_intern("rawtext"));
+
+  parser_contexts = rb_ary_new_from_values(PARSER_CONTEXT_COUNT, parser_context_symbols);
+  rb_ary_push(parser_contexts, rawtext_symbol);
+  rb_obj_freeze(parser_contexts);
+  rb_gc_register_address(&parser_contexts);
+}
+
+static VALUE parser_context_method(VALUE self)
+{
+  struct parser_t *parser = NULL;
+
+  Parser_Get_Struct(self, parser);
+
+  if(parser->context == PARSER_NONE && parser_in_rawtext(parser))
+    return rawtext_symbol;
+  if((unsigned int)parser->context >= PARSER_CONTEXT_COUNT)
+    return Qnil;
+  return parser_context_symbols[parser->context];
+}
+
+/* Returns the text of ref as a frozen string, the same one for as long
+  as ref points at the same text. */
+static VALUE ref_to_str(struct rb_parser_t *rb_parser, struct token_reference_t *ref, enum parser_string which, int is_name)
+{
+  struct parser_t *parser = &rb_parser->parser;
+  struct parser_string_cache_t *cache;
+  rb_encoding *enc;
+
+  if(ref->type == TOKEN_NONE || !parser->doc.is_started)
+    return Qnil;
+
+  cache = &rb_parser->strings[which];
+  if(cache->string != Qnil && cache->start == ref->start && cache->length == ref->length)
+    return cache->string;
+
+  enc = rb_enc_from_index(parser->doc.enc_index);
+  if(is_name && rb_parser->intern_names)
+    cache->string = interned_str(parser->doc.data + ref->start, ref->length, enc);
+  else
+    cache->string = rb_obj_freeze(rb_enc_str_new(parser->doc.data + ref->start, ref->length, enc));
+  cache->start = ref->start;
+  cache->length = ref->length;
+  return cache->string;
+}
+
+static VALUE parser_tag_name_method(VALUE self)
+{
+  struct rb_parser_t *rb_parser = NULL;
+  RbParser_Get_Struct(self, rb_parser);
+  return ref_to_str(rb_parser, &rb_parser->parser.tag.name, PARSER_STRING_TAG_NAME, 1);
+}
+
+static VALUE parser_closing_tag_method(VALUE self)
+{
+  struct parser_t *parser = NULL;
+  Parser_Get_Struct(self, parser);
+  return parser->tk.is_closing_tag ? Qtrue : Qfalse;
+}
+
+static VALUE parser_self_closing_tag_method(VALUE self)
+{
+  struct parser_t *parser = NULL;
+  Parser_Get_Struct(self, parser);
+  return parser->tag.self_closing ? Qtrue : Qfalse;
+}
+
+static VALUE parser_attribute_name_method(VALUE self)
+{
+  struct rb_parser_t *rb_parser = NULL;
+  RbParser_Get_Struct(self, rb_parser);
+  return ref_to_str(rb_parser, &rb_parser->parser.attribute.name, PARSER_STRING_ATTRIBUTE_NAME, 1);
+}
+
+static VALUE parser_attribute_value_method(VALUE self)
+{
+  struct rb_parser_t *rb_parser = NULL;
+  RbParser_Get_Struct(self, rb_parser);
+  return ref_to_str(rb_parser, &rb_parser->parser.attribute.value, PARSER_STRING_ATTRIBUTE_VALUE, 0);
+}
+
+static VALUE parser_quote_character_method(VALUE self)
+{
+  struct parser_t *parser = NULL;
+  Parser_Get_Struct(self, parser);
+  return parser->attribute.is_quoted ?
+    rb_str_new(&parser->tk.attribute_value_start, 1) :
+    Qnil;
+}
+
+static VALUE parser_attribute_is_quoted_method(VALUE self)
+{
+  struct parser_t *parser = NULL;
+  Parser_Get_Struct(self, parser);
+  return parser->attribute.is_quoted ? Qtrue : Qfalse;
+}
+
+static VALUE parser_comment_text_method(VALUE self)
+{
+  struct rb_parser_t *rb_parser = NULL;
+  RbParser_Get_Struct(self, rb_parser);
+  return ref_to_str(rb_parser, &rb_parser->parser.comment.text, PARSER_STRING_COMMENT_TEXT, 0);
+}
+
+static VALUE parser_cdata_text_method(VALUE self)
+{
+  struct rb_parser_t *rb_parser = NULL;
+  RbParser_Get_Struct(self, rb_parser);
+  return ref_to_str(rb_parser, &rb_parser->parser.cdata.text, PARSER_STRING_CDATA_TEXT, 0);
+}
+
+static VALUE parser_rawtext_text_method(VALUE self)
+{
+  struct rb_parser_t *rb_parser = NULL;
+  RbParser_Get_Struct(self, rb_parser);
+  return ref_to_str(rb_parser, &rb_parser->parser.rawtext.text, PARSER_STRING_RAWTEXT_TEXT, 0);
+}
+
+static VALUE parser_errors_count_method(VALUE self)
+{
+  struct parser_t *parser = NULL;
+  Parser_Get_Struct(self, parser);
+  return ULONG2NUM(parser->errors_count);
+}
+
+static VALUE create_parser_error(VALUE klass, struct parser_t *parser, struct parser_document_error_t *error)
+{
+  long unsigned int line_number, column_number;
+  VALUE args[4];
+
+  parser_line_and_column(parser, error->pos, error->mb_pos, &line_number, &column_number);
+  args[0] = rb_str_new2(parser_error_message(error->error));
+  args[1] = ULONG2NUM(error->mb_pos);
+  args[2] = ULONG2NUM(line_number);
+  args[3] = ULONG2NUM(column_number);
+  return rb_class_new_instance(4, args, klass);
+}
+
+static VALUE parser_errors_method(VALUE self)
+{
+  struct parser_t *parser = NULL;
+  VALUE list, klass;
+  size_t i;
+  Parser_Get_Struct(self, parser);
+
+  list = rb_ary_new_capa(parser->errors_count);
+  if(!parser->errors_count)
+    return list;
+
+  klass = rb_const_get(rb_const_get(rb_cObject, rb_intern("HtmlTokenizer")), rb_intern("ParserError"));
+  for(i=0; i<parser->errors_count; i++)
+    rb_ary_push(list, create_parser_error(klass, parser, &parser->errors[i]));
+
+  return list;
+}
+
+static VALUE parser_line_number_method(VALUE self)
+{
+  struct parser_t *parser = NULL;
+  long unsigned int line_number, column_number;
+  Parser_Get_Struct(self, parser);
+  parser_line_and_column(parser, parser->tk.scan.cursor, parser->tk.scan.mb_cursor, &line_number, &column_number);
+  return ULONG2NUM(line_number);
+}
+
+static VALUE parser_column_number_method(VALUE self)
+{
+  struct parser_t *parser = NULL;
+  long unsigned int line_number, column_number;
+  Parser_Get_Struct(self, parser);
+  parser_line_and_column(parser, parser->tk.scan.cursor, parser->tk.scan.mb_cursor, &line_number, &column_number);
+  return ULONG2NUM(column_number);
+}
+
+static VALUE buffer_stats(size_t capacity, size_t used)
+{
+  VALUE stats = rb_hash_new();
+  rb_hash_aset(stats, ID2SYM(rb_intern("capacity")), SIZET2NUM(capacity));
+  rb_hash_aset(stats, ID2SYM(rb_intern("used")), SIZET2NUM(used));
+  return stats;
+}
+
+/* Bytes held by the parser, the struct itself and then each buffer it
+  owns by allocated capacity and bytes in use; :total is what the
+  parser reports to the GC. */
+static VALUE parser_memory_stats_method(VALUE self)
+{
+  struct parser_t *parser = NULL;
+  VALUE stats;
+  Parser_Get_Struct(self, parser);
+
+  stats = rb_hash_new();
+  rb_hash_aset(stats, ID2SYM(rb_intern("struct")), SIZET2NUM(sizeof(struct rb_parser_t)));
+  rb_hash_aset(stats, ID2SYM(rb_intern("document")),
+    buffer_stats(parser->doc.capacity, parser->doc.is_started ? parser->doc.length + 1 : 0));
+  rb_hash_aset(stats, ID2SYM(rb_intern("errors")),
+    buffer_stats(parser->errors_capacity * sizeof(struct parser_document_error_t),
+      parser->errors_count * sizeof(struct parser_document_error_t)));
+  rb_hash_aset(stats, ID2SYM(rb_intern("attributes")),
+    buffer_stats(parser->attributes_capacity * sizeof(struct parser_attribute_t),
+      parser->attributes_count * sizeof(struct parser_attribute_t)));
+  rb_hash_aset(stats, ID2SYM(rb_intern("lines")),
+    buffer_stats(parser_lines_allocated_size(parser),
+      (parser->lines.count + parser->lines.appends_count) * sizeof(struct parser_offset_t)));
+  rb_hash_aset(stats, ID2SYM(rb_intern("total")), SIZET2NUM(parser_memsize(RTYPEDDATA_DATA(self))));
+  return stats;
+}
+
+void Init_html_tokenizer_parser(VALUE mHtmlTokenizer)
+{
+  int i;
+
+  init_parser_context_symbols();
+  for(i = 0; i < PARSER_EVENT_TYPE_COUNT; i++)
+    parser_event_symbols[i] = ID2SYM(rb_intern(parser_event_type_name(i)));
+
+  cParser = rb_define_class_under(mHtmlTokenizer, "Parser", rb_cObject);
+  rb_define_const(cParser, "CONTEXTS", parser_contexts);
+  rb_define_alloc_func(cParser, parser_allocate);
+  rb_define_method(cParser, "initialize", parser_initialize_method, -1);
+  rb_define_method(cParser, "reset", parser_reset_method, 0);
+  rb_define_method(cParser, "document", parser_document_method, 0);
+  rb_define_method(cParser, "document_length", parser_document_length_method, 0);
+  rb_define_method(cParser, "document_bytesize", parser_document_bytesize_method, 0);
+  rb_define_method(cParser, "document_line_count", parser_document_line_count_method, 0);
+  rb_define_method(cParser, "line_number", parser_line_number_method, 0);
+  rb_define_method(cParser, "column_number", parser_column_number_method, 0);
+  rb_define_method(cParser, "parse", parser_parse_method, -1);
+  rb_define_method(cParser, "parse_tokens", parser_parse_tokens_method, 1);
+  rb_define_method(cParser, "parse_events", parser_parse_events_method, 1);
+  rb_define_method(cParser, "parse_file", parser_parse_file_method, -1);
+  rb_define_method(cParser, "append_placeholder", parser_append_placeholder_method, 1);
+  rb_define_method(cParser, "context", parser_context_method, 0);
+  rb_define_method(cParser, "tag_name", parser_tag_name_method, 0);
+  rb_define_method(cParser, "closing_tag?", parser_closing_tag_method, 0);
+  rb_define_method(cParser, "self_closing_tag?", parser_self_closing_tag_method, 0);
+  rb_define_method(cParser, "attribute_name", parser_attribute_name_method, 0);
+  rb_define_method(cParser, "attribute_value", parser_attribute_value_method, 0);
+  rb_define_method(cParser, "quote_character", parser_quote_character_method, 0);
+  rb_define_method(cParser, "attribute_quoted?", parser_attribute_is_quoted_method, 0);
+  rb_define_method(cParser, "comment_text", parser_comment_text_method, 0);
+  rb_define_method(cParser, "cdata_text", parser_cdata_text_method, 0);
+  rb_define_method(cParser, "rawtext_text", parser_rawtext_text_method, 0);
+
+  rb_define_method(cParser, "errors_count", parser_errors_count_method, 0);
+  rb_define_method(cParser, "errors", parser_errors_method, 0);
+  rb_define_method(cParser, "memory_stats", parser_memory_stats_method, 0);
+}
@@ -0,0 +1,119 @@
+#include <ruby.h>
+#include "html_tokenizer.h"
+
+static VALUE cTokenBuffer = Qnil;
+
+static void token_buffer_mark(void *ptr)
+{}
+
+static void token_buffer_free(void *ptr)
+{
+  struct token_buffer_t *buffer = ptr;
+  if(buffer) {
+    token_buffer_free_members(buffer);
+    DBG_PRINT("buffer=%p xfree(buffer)", buffer);
+    xfree(buffer);
+  }
+}
+
+static size_t token_buffer_memsize(const void *ptr)
+{
+  const struct token_buffer_t *buffer = ptr;
+  return buffer ? sizeof(struct token_buffer_t) + buffer->capacity * sizeof(struct token_entry_t) : 0;
+}
+
+const rb_data_type_t ht_token_buffer_data_type = {
+  "ht_token_buffer_data_type",
+  { token_buffer_mark, token_buffer_free, token_buffer_memsize, },
+#if defined(RUBY_TYPED_FREE_IMMEDIATELY)
+  NULL, NULL, RUBY_TYPED_FREE_IMMEDIATELY
+#endif
+};
+
+static VALUE token_buffer_allocate(VALUE klass)
+{
+  VALUE obj;
+  struct token_buffer_t *buffer = NULL;
+
+  obj = TypedData_Make_Struct(klass, struct token_buffer_t, &ht_token_buffer_data_type, buffer);
+  DBG_PRINT("buffer=%p allocate", buffer);
+
+  buffer->count = 0;
+  buffer->capacity = 0;
+  buffer->tokens = NULL;
+
+  return obj;
+}
+
+VALUE token_buffer_new(struct token_buffer_t **buffer)
+{
+  VALUE obj = token_buffer_allocate(cTokenBuffer);
+  TokenBuffer_Get_Struct(obj, *buffer);
+  return obj;
+}
+
+static struct token_entry_t *token_buffer_entry(VALUE self, VALUE index)
+{
+  struct token_buffer_t *buffer = NULL;
+  long i = NUM2LONG(index);
+
+  TokenBuffer_Get_Struct(self, buffer);
+  if(i < 0)
+    i += buffer->count;
+  if(i < 0 || (size_t)i >= buffer->count)
+    return NULL;
+  return &buffer->tokens[i];
+}
+
+static VALUE token_buffer_size_method(VALUE self)
+{
+  struct token_buffer_t *buffer = NULL;
+  TokenBuffer_Get_Struct(self, buffer);
+  return ULONG2NUM(buffer->count);
+}
+
+static VALUE token_buffer_aref_method(VALUE self, VALUE index)
+{
+  struct token_entry_t *entry = token_buffer_entry(self, index);
+  if(!entry)
+    return Qnil;
+  return rb_ary_new_from_args(5, token_type_to_symbol(entry->type),
+    ULONG2NUM(entry->mb_start), ULONG2NUM(entry->mb_start + entry->mb_length),
+    ULONG2NUM(entry->line_number), ULONG2NUM(entry->column_number));
+}
+
+static VALUE token_buffer_type_method(VALUE self, VALUE index)
+{
+  struct token_entry_t *entry = token_buffer_entry(self, index);
+  return entry ? token_type_to_symbol(entry->type) : Qnil;
+}
+
+static VALUE token_buffer_type_id_method(VALUE self, VALUE index)
+{
+  struct token_entry_t *entry = token_buffer_entry(self, index);
+  return entry ? INT2FIX(entry->type) : Qnil;
+}
+
+static VALUE token_buffer_byte_start_method(VALUE self, VALUE index)
+{
+  struct token_entry_t *entry = token_buffer_entry(self, index);
+  return entry ? ULONG2NUM(entry->start) : Qnil;
+}
+
+static VALUE token_buffer_byte_end_method(VALUE self, VALUE index)
+{
+  struct token_entry_t *entry = token_buffer_entry(self, index);
+  return entry ? ULONG2NUM(entry->start + entry->length) : Qnil;
+}
+
+void Init_html_tokenizer_token_buffer(VALUE mHtmlTokenizer)
+{
+  cTokenBuffer = rb_define_class_under(mHtmlTokenizer, "TokenBuffer", rb_cObject);
+  rb_undef_alloc_func(cTokenBuffer);
+  rb_define_method(cTokenBuffer, "size", token_buffer_size_method, 0);
+  rb_define_method(cTokenBuffer, "[]", token_buffer_aref_method, 1);
+  rb_define_method(cTokenBuffer, "type", token_buffer_type_method, 1);
+  rb_define_method(cTokenBuffer, "type_id", token_buffer_type_id_method, 1);
+  rb_define_method(cTokenBuffer, "byte_start", token_buffer_byte_start_method, 1);
+  rb_define_method(cTokenBuffer, "byte_end", token_buffer_byte_end_method, 1);
+}
@@ -0,0 +1,139 @@
+#include <ruby.h>
+#include <ruby/encoding.h>
+#include "html_tokenizer.h"
+
+static VALUE cTokenIterator = Qnil;
+
+/* tokens scanned ahead of the caller at a time */
+#define TOKEN_ITERATOR_BATCH 64
+
+/* Scans its own copy of the tokenizer over the source on demand, a
+  batch of tokens at a time, so tokens can be pulled one by one
+  without a block or a fiber. */
+struct token_iterator_t {
+  struct tokenizer_t tk;
+  struct token_buffer_t tokens;
+  size_t next;
+  int is_done;
+  VALUE source;
+};
+
+static void token_iterator_mark(void *ptr)
+{
+  struct token_iterator_t *it = ptr;
+  /* pinned, the tokenizer points into the string's bytes */
+  if(it)
+    rb_gc_mark(it->source);
+}
+
+static void token_iterator_free(void *ptr)
+{
+  struct token_iterator_t *it = ptr;
+  if(it) {
+    tokenizer_free_members(&it->tk);
+    token_buffer_free_members(&it->tokens);
+    DBG_PRINT("it=%p xfree(it)", it);
+    xfree(it);
+  }
+}
+
+static size_t token_iterator_memsize(const void *ptr)
+{
+  const struct token_iterator_t *it = ptr;
+  return it ? sizeof(struct token_iterator_t) + it->tokens.capacity * sizeof(struct token_entry_t) : 0;
+}
+
+static const rb_data_type_t ht_token_iterator_data_type = {
+  "ht_token_iterator_data_type",
+  { token_iterator_mark, token_iterator_free, token_iterator_memsize, },
+#if defined(RUBY_TYPED_FREE_IMMEDIATELY)
+  NULL, NULL, RUBY_TYPED_FREE_IMMEDIATELY
+#endif
+};
+
+#define TokenIterator_Get_Struct(obj, sval) TypedData_Get_Struct(obj, struct token_iterator_t, &ht_token_iterator_data_type, sval)
+
+/* Starts scanning source, a string, from the context tk is in. tk
+  itself is left alone. */
+VALUE token_iterator_new(struct tokenizer_t *tk, VALUE source, uint32_t token_mask)
+{
+  VALUE obj;
+  struct token_iterator_t *it = NULL;
+  char *c_source;
+
+  source = rb_str_new_frozen(source);
+  c_source = StringValueCStr(source);
+
+  obj = TypedData_Make_Struct(cTokenIterator, struct token_iterator_t, &ht_token_iterator_data_type, it);
+  DBG_PRINT("it=%p allocate", it);
+
+  tokenizer_init(&it->tk);
+  tokenizer_copy_state(&it->tk, tk);
+  it->tk.f_callback = token_buffer_callback;
+  it->tk.callback_data = &it->tokens;
+  it->tk.token_mask = token_mask;
+  tokenizer_set_encoding(&it->tk, rb_enc_get_index(source));
+  tokenizer_borrow_scan_string(&it->tk, c_source, strlen(c_source));
+  it->source = source;
+
+  return obj;
+}
+
+/* Refills the batch once the caller has taken every token in it.
+  Returns the next token, NULL at the end of the source. */
+static struct token_entry_t *token_iterator_peek_entry(struct token_iterator_t *it)
+{
+  if(it->next < it->tokens.count)
+    return &it->tokens.tokens[it->next];
+
+  it->tokens.count = 0;
+  it->next = 0;
+  while(!it->is_done && it->tokens.count < TOKEN_ITERATOR_BATCH) {
+    if(!tokenizer_scan_step(&it->tk)) {
+      it->is_done = 1;
+      tokenizer_report_context_overflow(&it->tk);
+      tokenizer_free_scan_string(&it->tk);
+    }
+  }
+  return it->tokens.count ? &it->tokens.tokens[0] : NULL;
+}
+
+static VALUE token_entry_to_ary(const struct token_entry_t *entry)
+{
+  return rb_ary_new_from_args(3, token_type_to_symbol(entry->type),
+    ULONG2NUM(entry->mb_start), ULONG2NUM(entry->mb_start + entry->mb_length));
+}
+
+/* The next token as [type, start, stop], like Tokenizer#tokenize
+  yields them. Raises StopIteration at the end of the source. */
+static VALUE token_iterator_next_method(VALUE self)
+{
+  struct token_iterator_t *it = NULL;
+  struct token_entry_t *entry;
+
+  TokenIterator_Get_Struct(self, it);
+  if(!(entry = token_iterator_peek_entry(it)))
+    rb_raise(rb_eStopIteration, "iteration reached an end");
+  it->next++;
+  return token_entry_to_ary(entry);
+}
+
+/* The token #next returns next, without moving past it. */
+static VALUE token_iterator_peek_method(VALUE self)
+{
+  struct token_iterator_t *it = NULL;
+  struct token_entry_t *entry;
+
+  TokenIterator_Get_Struct(self, it);
+  if(!(entry = token_iterator_peek_entry(it)))
+    rb_raise(rb_eStopIteration, "iteration reached an end");
+  return token_entry_to_ary(entry);
+}
+
+void Init_html_tokenizer_token_iterator(VALUE mHtmlTokenizer)
+{
+  cTokenIterator = rb_define_class_under(mHtmlTokenizer, "TokenIterator", rb_cObject);
+  rb_undef_alloc_func(cTokenIterator);
+  rb_define_method(cTokenIterator, "next", token_iterator_next_method, 0);
+  rb_define_method(cTokenIterator, "peek", token_iterator_peek_method, 0);
+}
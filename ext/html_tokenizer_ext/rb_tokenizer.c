@@ -0,0 +1,469 @@
+#include <ruby.h>
+#include <ruby/encoding.h>
+#include <ruby/thread.h>
+#include "html_tokenizer.h"
+#include "parallel.h"
+#include "mapped_file.h"
+
+static VALUE cTokenizer = Qnil;
+
+/* read size for files that can't be mapped */
+#define TOKENIZER_FILE_CHUNK_LENGTH (64 * 1024)
+
+/* inputs at least this long are scanned with the GVL released when
+  no block needs to be called back */
+#define TOKENIZER_WITHOUT_GVL_THRESHOLD (64 * 1024)
+
+static void tokenizer_mark(void *ptr)
+{}
+
+static void tokenizer_free(void *ptr)
+{
+  struct tokenizer_t *tk = ptr;
+  if(tk) {
+    tokenizer_free_members(tk);
+    DBG_PRINT("tk=%p xfree(tk)", tk);
+    xfree(tk);
+  }
+}
+
+static size_t tokenizer_memsize(const void *ptr)
+{
+  return ptr ? sizeof(struct tokenizer_t) + tokenizer_allocated_size(ptr) : 0;
+}
+
+const rb_data_type_t ht_tokenizer_data_type = {
+  "ht_tokenizer_data_type",
+  { tokenizer_mark, tokenizer_free, tokenizer_memsize, },
+#if defined(RUBY_TYPED_FREE_IMMEDIATELY)
+  NULL, NULL, RUBY_TYPED_FREE_IMMEDIATELY
+#endif
+};
+
+static VALUE tokenizer_allocate(VALUE klass)
+{
+  VALUE obj;
+  struct tokenizer_t *tokenizer = NULL;
+
+  obj = TypedData_Make_Struct(klass, struct tokenizer_t, &ht_tokenizer_data_type, tokenizer);
+  DBG_PRINT("tk=%p allocate", tokenizer);
+
+  memset((void *)tokenizer, 0, sizeof(struct tokenizer_t));
+
+  return obj;
+}
+
+static VALUE token_types = Qnil;
+static VALUE token_type_symbols[TOKEN_TYPE_COUNT];
+
+VALUE token_type_to_symbol(enum token_type type)
+{
+  if((unsigned int)type >= TOKEN_TYPE_COUNT)
+    return Qnil;
+  return token_type_symbols[type];
+}
+
+static uint32_t token_types_to_mask(VALUE types)
+{
+  uint32_t mask = 0;
+  VALUE type;
+  long i;
+  int j;
+
+  types = rb_Array(types);
+  for(i = 0; i < RARRAY_LEN(types); i++) {
+    type = rb_ary_entry(types, i);
+    for(j = 0; j < TOKEN_TYPE_COUNT && token_type_symbols[j] != type; j++) {}
+    if(j == TOKEN_TYPE_COUNT || j == TOKEN_NONE)
+      rb_raise(rb_eArgError, "unknown token type %"PRIsVALUE, rb_inspect(type));
+    mask |= TOKEN_MASK(j);
+  }
+  return mask;
+}
+
+/* Reads the only: or except: option, token type symbols to pass to
+  the block or to leave out, into a token mask. */
+uint32_t token_mask_option(VALUE options)
+{
+  VALUE values[2] = { Qundef, Qundef };
+  ID keywords[2];
+
+  if(NIL_P(options))
+    return TOKEN_MASK_ALL;
+
+  keywords[0] = rb_intern("only");
+  keywords[1] = rb_intern("except");
+  rb_get_kwargs(options, keywords, 0, 2, values);
+  if(values[0] != Qundef && values[1] != Qundef)
+    rb_raise(rb_eArgError, "only: and except: cannot be combined");
+  if(values[0] != Qundef)
+    return token_types_to_mask(values[0]);
+  if(values[1] != Qundef)
+    return TOKEN_MASK_ALL & ~token_types_to_mask(values[1]);
+  return TOKEN_MASK_ALL;
+}
+
+static void init_token_type_symbols(VALUE mHtmlTokenizer)
+{
+  int i;
+
+  for(i = 0; i < TOKEN_TYPE_COUNT; i++)
+    token_type_symbols[i] = ID2SYM(rb_intern(tokenizer_token_type_name(i)));
+
+  token_types = rb_obj_freeze(rb_ary_new_from_values(TOKEN_TYPE_COUNT, token_type_symbols));
+  rb_gc_register_address(&token_types);
+  rb_define_const(mHtmlTokenizer, "TOKEN_TYPES", token_types);
+}
+
+static VALUE stop_symbol = Qnil;
+
+static void tokenizer_yield_tag(struct tokenizer_t *tk, enum token_type type, long unsigned int length, long unsigned int mb_length, void *data)
+{
+  VALUE result;
+
+  tk->last_token = type;
+  result = rb_yield_values(3, token_type_to_symbol(type), ULONG2NUM(tk->scan.mb_cursor), ULONG2NUM(tk->scan.mb_cursor + mb_length));
+  if(result == stop_symbol)
+    tk->is_stopped = 1;
+}
+
+/* true when the last scan ran through its input, otherwise where the
+  block stopped it. */
+static VALUE tokenizer_scan_result(struct tokenizer_t *tk)
+{
+  VALUE args[4], klass;
+
+  if(!tk->is_stopped)
+    return Qtrue;
+
+  klass = rb_const_get(rb_const_get(rb_cObject, rb_intern("HtmlTokenizer")), rb_intern("StopPosition"));
+  args[0] = ULONG2NUM(tk->stop_offset);
+  args[1] = ULONG2NUM(tk->scan.mb_cursor);
+  args[2] = ULONG2NUM(tk->scan.line_number);
+  args[3] = ULONG2NUM(tk->scan.column_number);
+  return rb_class_new_instance(4, args, klass);
+}
+
+static VALUE tokenizer_initialize_method(VALUE self)
+{
+  struct tokenizer_t *tk = NULL;
+
+  Tokenizer_Get_Struct(self, tk);
+  DBG_PRINT("tk=%p initialize", tk);
+
+  if(tk->is_scanning_without_gvl)
+    rb_raise(rb_eRuntimeError, "tokenizer is already scanning in another thread");
+
+  tokenizer_free_members(tk);
+  tokenizer_init(tk);
+  tk->f_callback = tokenizer_yield_tag;
+
+  return Qnil;
+}
+
+/* Drops any stream in progress and starts over from html. */
+static VALUE tokenizer_reset_method(VALUE self)
+{
+  struct tokenizer_t *tk = NULL;
+
+  Tokenizer_Get_Struct(self, tk);
+
+  if(tk->is_scanning_without_gvl)
+    rb_raise(rb_eRuntimeError, "tokenizer is already scanning in another thread");
+
+  tokenizer_reset(tk);
+
+  return self;
+}
+
+/* Called from the block, ends the scan after the current token like
+  returning :stop does. The rest of the input is left unscanned and a
+  stream in progress is dropped. */
+static VALUE tokenizer_stop_method(VALUE self)
+{
+  struct tokenizer_t *tk = NULL;
+
+  Tokenizer_Get_Struct(self, tk);
+
+  if(tk->is_scanning_without_gvl)
+    rb_raise(rb_eRuntimeError, "tokenizer is already scanning in another thread");
+
+  tk->is_stopped = 1;
+
+  return Qnil;
+}
+
+static void *tokenizer_scan_all_without_gvl(void *data)
+{
+  tokenizer_scan_all((struct tokenizer_t *)data);
+  return NULL;
+}
+
+struct tokenizer_source_scan_t {
+  struct tokenizer_t *tk;
+  struct token_buffer_t *buffer;
+  int threads;
+};
+
+/* Tokens are yielded to the block, or pushed to buffer when given.
+  Buffered scans of large inputs run with the GVL released since they
+  touch no Ruby objects, split across threads when more than one is
+  allowed; xrealloc of the buffer is fine there, the VM reacquires
+  the lock itself when an allocation needs to start a GC. */
+static VALUE tokenizer_scan_source_body(VALUE arg)
+{
+  struct tokenizer_source_scan_t *ss = (struct tokenizer_source_scan_t *)arg;
+  struct tokenizer_t *tk = ss->tk;
+
+  if(ss->buffer) {
+    tk->f_callback = token_buffer_callback;
+    tk->callback_data = ss->buffer;
+    if(tk->scan.length >= TOKENIZER_WITHOUT_GVL_THRESHOLD) {
+      tk->is_scanning_without_gvl = 1;
+      if(ss->threads < 2 || !parallel_scan_all(tk, ss->buffer, ss->threads))
+        rb_thread_call_without_gvl(tokenizer_scan_all_without_gvl, tk, NULL, NULL);
+    }
+    else {
+      tokenizer_scan_all(tk);
+    }
+  }
+  else {
+    tokenizer_scan_all(tk);
+  }
+  return Qnil;
+}
+
+/* Runs even when an interrupt is raised as the GVL is taken back, so
+  the tokenizer never stays marked as scanning. */
+static VALUE tokenizer_scan_source_ensure(VALUE arg)
+{
+  struct tokenizer_t *tk = ((struct tokenizer_source_scan_t *)arg)->tk;
+
+  tk->is_scanning_without_gvl = 0;
+  tk->f_callback = tokenizer_yield_tag;
+  tk->callback_data = NULL;
+  tk->token_mask = TOKEN_MASK_ALL;
+  tokenizer_free_scan_string(tk);
+  return Qnil;
+}
+
+static void tokenizer_scan_source(struct tokenizer_t *tk, VALUE source, struct token_buffer_t *buffer, int threads,
+  uint32_t token_mask)
+{
+  struct tokenizer_source_scan_t ss = { tk, buffer, threads };
+  char *c_source = StringValueCStr(source);
+
+  if(tk->is_scanning_without_gvl)
+    rb_raise(rb_eRuntimeError, "tokenizer is already scanning in another thread");
+
+  tk->scan.cursor = 0;
+  tokenizer_set_scan_string(tk, c_source, strlen(c_source));
+  tokenizer_set_encoding(tk, rb_enc_get_index(source));
+  tk->scan.mb_cursor = 0;
+  tk->scan.line_number = 1;
+  tk->scan.column_number = 0;
+  tk->token_mask = token_mask;
+
+  rb_ensure(tokenizer_scan_source_body, (VALUE)&ss, tokenizer_scan_source_ensure, (VALUE)&ss);
+  tokenizer_report_context_overflow(tk);
+}
+
+/* With only: or except:, the tokens left out are never yielded and
+  cost little more than the scan itself. */
+static VALUE tokenizer_tokenize_method(int argc, VALUE *argv, VALUE self)
+{
+  struct tokenizer_t *tk = NULL;
+  VALUE source, options;
+  uint32_t token_mask;
+
+  rb_scan_args(argc, argv, "1:", &source, &options);
+  token_mask = token_mask_option(options);
+  if(NIL_P(source))
+    return Qnil;
+
+  Check_Type(source, T_STRING);
+  Tokenizer_Get_Struct(self, tk);
+
+  tokenizer_scan_source(tk, source, NULL, 1, token_mask);
+
+  return tokenizer_scan_result(tk);
+}
+
+static VALUE tokenizer_tokenize_to_buffer_method(int argc, VALUE *argv, VALUE self)
+{
+  struct tokenizer_t *tk = NULL;
+  struct token_buffer_t *buffer = NULL;
+  VALUE source, options, tokens, threads = Qundef;
+  ID keywords[1];
+
+  rb_scan_args(argc, argv, "1:", &source, &options);
+  if(!NIL_P(options)) {
+    keywords[0] = rb_intern("threads");
+    rb_get_kwargs(options, keywords, 0, 1, &threads);
+  }
+  if(NIL_P(source))
+    return Qnil;
+
+  Check_Type(source, T_STRING);
+  Tokenizer_Get_Struct(self, tk);
+
+  tokens = token_buffer_new(&buffer);
+  tokenizer_scan_source(tk, source, buffer, threads == Qundef ? 1 : NUM2INT(threads), TOKEN_MASK_ALL);
+
+  return tokens;
+}
+
+/* Returns a TokenIterator over source, which scans it as its tokens
+  are asked for, starting from this tokenizer's context. */
+static VALUE tokenizer_each_token_method(int argc, VALUE *argv, VALUE self)
+{
+  struct tokenizer_t *tk = NULL;
+  VALUE source, options;
+  uint32_t token_mask;
+
+  rb_scan_args(argc, argv, "1:", &source, &options);
+  token_mask = token_mask_option(options);
+  Check_Type(source, T_STRING);
+  Tokenizer_Get_Struct(self, tk);
+
+  if(tk->is_scanning_without_gvl)
+    rb_raise(rb_eRuntimeError, "tokenizer is already scanning in another thread");
+
+  return token_iterator_new(tk, source, token_mask);
+}
+
+/* Feeds the next chunk of a stream, yielding every token it completes.
+  The chunk is copied so the caller may reuse it, and all chunks must
+  share the encoding of the first one. */
+static void tokenizer_scan_stream(struct tokenizer_t *tk, VALUE chunk, int is_final)
+{
+  const char *string = "";
+  long unsigned int length = 0;
+
+  if(tk->is_scanning_without_gvl)
+    rb_raise(rb_eRuntimeError, "tokenizer is already scanning in another thread");
+
+  if(!NIL_P(chunk)) {
+    if(!tk->scan.is_partial) {
+      tokenizer_set_encoding(tk, rb_enc_get_index(chunk));
+    }
+    else if(tk->scan.enc_index != rb_enc_get_index(chunk)) {
+      rb_raise(rb_eArgError, "cannot append %s string to %s stream",
+        rb_enc_name(rb_enc_get(chunk)), rb_enc_name(rb_enc_from_index(tk->scan.enc_index)));
+    }
+    string = StringValueCStr(chunk);
+    length = strlen(string);
+  }
+
+  tk->token_mask = TOKEN_MASK_ALL;
+  tokenizer_scan_chunk(tk, string, length, is_final);
+  tokenizer_report_context_overflow(tk);
+}
+
+static VALUE tokenizer_feed_method(VALUE self, VALUE chunk)
+{
+  struct tokenizer_t *tk = NULL;
+
+  if(NIL_P(chunk))
+    return Qnil;
+
+  Check_Type(chunk, T_STRING);
+  Tokenizer_Get_Struct(self, tk);
+
+  tokenizer_scan_stream(tk, chunk, 0);
+
+  return tokenizer_scan_result(tk);
+}
+
+static VALUE tokenizer_finish_method(VALUE self)
+{
+  struct tokenizer_t *tk = NULL;
+
+  Tokenizer_Get_Struct(self, tk);
+
+  tokenizer_scan_stream(tk, Qnil, 1);
+
+  return tokenizer_scan_result(tk);
+}
+
+struct tokenizer_file_scan_t {
+  struct tokenizer_t *tk;
+  struct mapped_file_t file;
+};
+
+/* Mapped files are scanned in place, anything else is streamed. */
+static VALUE tokenizer_scan_file(VALUE arg)
+{
+  struct tokenizer_file_scan_t *fs = (struct tokenizer_file_scan_t *)arg;
+  struct tokenizer_t *tk = fs->tk;
+  long unsigned int length;
+  VALUE chunk;
+
+  if(fs->file.is_mapped) {
+    tokenizer_borrow_scan_string(tk, fs->file.data, fs->file.length);
+    tk->scan.cursor = 0;
+    tk->scan.mb_cursor = 0;
+    tk->scan.line_number = 1;
+    tk->scan.column_number = 0;
+    tokenizer_scan_all(tk);
+  }
+  else {
+    chunk = rb_str_buf_new(TOKENIZER_FILE_CHUNK_LENGTH);
+    tokenizer_free_scan_string(tk);
+    while(!tk->is_stopped && (length = mapped_file_read(&fs->file, RSTRING_PTR(chunk), TOKENIZER_FILE_CHUNK_LENGTH)))
+      tokenizer_scan_chunk(tk, RSTRING_PTR(chunk), length, 0);
+    if(!tk->is_stopped)
+      tokenizer_scan_chunk(tk, "", 0, 1);
+    RB_GC_GUARD(chunk);
+  }
+  return Qnil;
+}
+
+static VALUE tokenizer_scan_file_ensure(VALUE arg)
+{
+  struct tokenizer_file_scan_t *fs = (struct tokenizer_file_scan_t *)arg;
+
+  tokenizer_free_scan_string(fs->tk);
+  mapped_file_close(&fs->file);
+  return Qnil;
+}
+
+static VALUE tokenizer_tokenize_file_method(int argc, VALUE *argv, VALUE self)
+{
+  struct tokenizer_file_scan_t fs;
+  VALUE path, options;
+  int enc_index;
+
+  rb_scan_args(argc, argv, "1:", &path, &options);
+  enc_index = mapped_file_encoding_option(options);
+  Tokenizer_Get_Struct(self, fs.tk);
+
+  if(fs.tk->is_scanning_without_gvl)
+    rb_raise(rb_eRuntimeError, "tokenizer is already scanning in another thread");
+
+  mapped_file_open(&fs.file, path);
+  tokenizer_set_encoding(fs.tk, enc_index);
+  fs.tk->token_mask = TOKEN_MASK_ALL;
+  rb_ensure(tokenizer_scan_file, (VALUE)&fs, tokenizer_scan_file_ensure, (VALUE)&fs);
+  tokenizer_report_context_overflow(fs.tk);
+
+  return tokenizer_scan_result(fs.tk);
+}
+
+void Init_html_tokenizer_tokenizer(VALUE mHtmlTokenizer)
+{
+  init_token_type_symbols(mHtmlTokenizer);
+  stop_symbol = ID2SYM(rb_intern("stop"));
+
+  cTokenizer = rb_define_class_under(mHtmlTokenizer, "Tokenizer", rb_cObject);
+  rb_define_alloc_func(cTokenizer, tokenizer_allocate);
+  rb_define_method(cTokenizer, "initialize", tokenizer_initialize_method, 0);
+  rb_define_method(cTokenizer, "reset", tokenizer_reset_method, 0);
+  rb_define_method(cTokenizer, "stop!", tokenizer_stop_method, 0);
+  rb_define_method(cTokenizer, "tokenize", tokenizer_tokenize_method, -1);
+  rb_define_method(cTokenizer, "tokenize_to_buffer", tokenizer_tokenize_to_buffer_method, -1);
+  rb_define_method(cTokenizer, "each_token", tokenizer_each_token_method, -1);
+  rb_define_method(cTokenizer, "tokenize_file", tokenizer_tokenize_file_method, -1);
+  rb_define_method(cTokenizer, "feed", tokenizer_feed_method, 1);
+  rb_define_method(cTokenizer, "finish", tokenizer_finish_method, 0);
+}
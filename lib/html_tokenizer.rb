@@ -1,6 +1,7 @@
 # frozen_string_literal: true
 
 require 'html_tokenizer_ext'
+require 'html_tokenizer/pool'
 
 module HtmlTokenizer
   class ParserError < RuntimeError
@@ -12,4 +13,47 @@ module HtmlTokenizer
       @column = column
     end
   end
+
+  # Returned by Tokenizer#tokenize, #feed, #finish and #tokenize_file
+  # when the block stopped the scan, by returning :stop or calling
+  # Tokenizer#stop!. The offsets are the end of the last token yielded.
+  StopPosition = Struct.new(:byte_offset, :char_offset, :line, :column)
+
+  class Tokenizer
+    # Tokenizes everything read from io, chunk_size bytes at a time,
+    # with offsets counted from the start of the stream. Only the token
+    # cut by the end of a chunk is held between chunks. Reading ends
+    # early when the block stops the scan.
+    def tokenize_io(io, chunk_size: 64 * 1024, encoding: Encoding::UTF_8, &block)
+      chunk = String.new(capacity: chunk_size)
+      while io.read(chunk_size, chunk)
+        result = feed(chunk.force_encoding(encoding), &block)
+        return result unless result == true
+      end
+      finish(&block)
+    end
+  end
+
+  class TokenIterator
+    include Enumerable
+
+    # Yields the tokens #next has not returned yet.
+    def each
+      return enum_for(:each) unless block_given?
+      loop { yield self.next }
+      self
+    end
+  end
+
+  class TokenBuffer
+    include Enumerable
+
+    alias_method :length, :size
+
+    def each
+      return enum_for(:each) { size } unless block_given?
+      size.times { |i| yield self[i] }
+      self
+    end
+  end
 end
@@ -0,0 +1,49 @@
+# frozen_string_literal: true
+
+require "objspace"
+
+module HtmlTokenizer
+  # Per-fiber pools of parsers and tokenizers. Objects are reset when
+  # the block returns and handed out again, keeping the buffers they
+  # grew, so parsing many templates doesn't allocate new ones each time.
+  #
+  #   HtmlTokenizer::Pool.with_parser do |parser|
+  #     parser.parse(source)
+  #   end
+  #
+  # The object must not be used after the block returns.
+  module Pool
+    # idle objects kept for each class and set of options
+    MAX_IDLE = 4
+    # objects holding more than this, counting every buffer reset
+    # keeps (document, errors, attributes, line index, context stack),
+    # are dropped rather than pooled, so one large template doesn't
+    # keep its buffers around
+    MAX_RETAINED_BYTES = 1024 * 1024
+
+    extend self
+
+    def with_parser(**options, &block)
+      with(Parser, options, &block)
+    end
+
+    def with_tokenizer(&block)
+      with(Tokenizer, {}, &block)
+    end
+
+    private
+
+    def with(klass, options)
+      pools = Thread.current[:html_tokenizer_pool] ||= {}
+      idle = pools[[klass, options]] ||= []
+      object = idle.pop || klass.new(**options)
+      begin
+        yield object
+      ensure
+        retain = idle.size < MAX_IDLE && ObjectSpace.memsize_of(object) <= MAX_RETAINED_BYTES
+        object.reset
+        idle.push(object) if retain
+      end
+    end
+  end
+end
@@ -1,5 +1,7 @@
 require "minitest/autorun"
 require "html_tokenizer"
+require "tempfile"
+require "objspace"
 
 class HtmlTokenizer::ParserTest < Minitest::Test
   def test_empty_context
@@ -384,6 +386,17 @@ class HtmlTokenizer::ParserTest < Minitest::Test
     assert_equal :none, @parser.context
   end
 
+  def test_contexts_constant
+    assert_predicate HtmlTokenizer::Parser::CONTEXTS, :frozen?
+    assert_equal :none, HtmlTokenizer::Parser::CONTEXTS[0]
+    assert_equal :rawtext, HtmlTokenizer::Parser::CONTEXTS.last
+    ["<div", "<div class='x", "<!-- x", "<![CDATA[ x", "<script>x"].each do |html|
+      @parser = nil
+      parse(html)
+      assert_includes HtmlTokenizer::Parser::CONTEXTS, @parser.context
+    end
+  end
+
   def test_document_length
     @parser = HtmlTokenizer::Parser.new
     assert_equal 0, @parser.document_length
@@ -393,6 +406,34 @@ class HtmlTokenizer::ParserTest < Minitest::Test
     assert_equal 12, @parser.document_length
   end
 
+  def test_document_length_when_block_breaks
+    @parser = HtmlTokenizer::Parser.new
+    @parser.parse("<a>hé</a>") { break }
+    assert_equal 9, @parser.document_length
+    assert_equal 10, @parser.document_bytesize
+    begin
+      @parser.parse("ab\ncd<x>") { raise "x" }
+    rescue RuntimeError
+    end
+    assert_equal 17, @parser.document_length
+    lengths = []
+    @parser.parse("<b>日本</b>") { lengths << @parser.document_length }
+    assert_equal [26], lengths.uniq
+    assert_equal 26, @parser.document_length
+  end
+
+  def test_document_bytesize_and_line_count
+    @parser = HtmlTokenizer::Parser.new
+    assert_equal 0, @parser.document_bytesize
+    assert_equal 0, @parser.document_line_count
+    parse("<p>é</p>\n")
+    @parser.append_placeholder("<%= a %>\n")
+    parse("日本")
+    assert_equal 20, @parser.document_length
+    assert_equal 25, @parser.document_bytesize
+    assert_equal 3, @parser.document_line_count
+  end
+
   def test_document_method
     @parser = HtmlTokenizer::Parser.new
     assert_nil @parser.document
@@ -402,6 +443,16 @@ class HtmlTokenizer::ParserTest < Minitest::Test
     assert_equal "abcdefabcdef", @parser.document
   end
 
+  def test_document_with_many_chunks
+    @parser = HtmlTokenizer::Parser.new
+    html = "<div class='foo'>bar</div>\n" * 100
+    html.each_char { |c| @parser.parse(c) }
+    assert_equal html, @parser.document
+    assert_equal html.size, @parser.document_length
+    assert_equal 101, @parser.line_number
+    assert_equal 0, @parser.errors_count
+  end
+
   def test_yields_raw_tokens_when_block_given
     tokens = []
     parse("<foo>") do |*token|
@@ -433,6 +484,83 @@ class HtmlTokenizer::ParserTest < Minitest::Test
     assert_equal [[:text, 0, 4, 1, 0], [:text, 34, 38, 5, 0]], tokens
   end
 
+  def test_line_and_column_numbers_across_chunks
+    parts = (1..60).map { |i| i % 5 == 0 ? [:placeholder, "<%= x\n %>"] : [:html, "<p a=\"é\n\" #{'b=' if i % 7 == 0}>日本\n\n#{i}</p> "] }
+    document = parts.map(&:last).join
+    expected_position = lambda do |offset|
+      before = document[0...offset]
+      [before.count("\n") + 1, offset - (before.rindex("\n") || -1) - 1]
+    end
+
+    tokens = []
+    @parser = HtmlTokenizer::Parser.new
+    parts.each do |kind, part|
+      if kind == :placeholder
+        @parser.append_placeholder(part)
+      else
+        part.scan(/.{1,4}/m) { |chunk| @parser.parse(chunk) { |name, start, _, line, column| tokens << [start, line, column] } }
+      end
+    end
+    tokens.each { |start, line, column| assert_equal expected_position.(start), [line, column] }
+    assert_equal 7, @parser.errors_count
+    @parser.errors.each { |error| assert_equal expected_position.(error.position), [error.line, error.column] }
+    assert_equal expected_position.(document.size), [@parser.line_number, @parser.column_number]
+    assert_equal document.count("\n") + 1, @parser.document_line_count
+
+    quiet = HtmlTokenizer::Parser.new
+    parts.each { |kind, part| kind == :placeholder ? quiet.append_placeholder(part) : quiet.parse(part) }
+    assert_equal [@parser.line_number, @parser.column_number], [quiet.line_number, quiet.column_number]
+    assert_equal @parser.errors.map { |e| [e.line, e.column] }, quiet.errors.map { |e| [e.line, e.column] }
+
+    broken = HtmlTokenizer::Parser.new
+    line_counts = []
+    parts.each_with_index do |(kind, part), i|
+      if kind == :placeholder
+        broken.append_placeholder(part)
+      else
+        broken.parse(part) do
+          line_counts << [broken.document_line_count, broken.document.count("\n") + 1]
+          break if i.odd?
+        end
+        broken.document_line_count
+      end
+    end
+    assert_equal [@parser.line_number, @parser.column_number], [broken.line_number, broken.column_number]
+    assert_equal document.count("\n") + 1, broken.document_line_count
+    assert_equal document.size, broken.document_length
+    line_counts.each { |count, expected| assert_equal expected, count }
+  end
+
+  def test_column_number_after_block_breaks
+    @parser = HtmlTokenizer::Parser.new
+    @parser.parse("<a>hello</a>") { break }
+    assert_equal 1, @parser.document_line_count
+    @parser.parse("<b>\nx</b>")
+    assert_equal [2, 5], [@parser.line_number, @parser.column_number]
+    assert_equal 2, @parser.document_line_count
+  end
+
+  def test_parse_tokens_returns_buffer_instead_of_yielding
+    @parser = HtmlTokenizer::Parser.new
+    tokens = @parser.parse_tokens("<div class='foo'\n") { flunk "should not yield" }
+    assert_equal [
+      [:tag_start, 0, 1, 1, 0],
+      [:tag_name, 1, 4, 1, 1],
+      [:whitespace, 4, 5, 1, 4],
+      [:attribute_name, 5, 10, 1, 5],
+      [:equal, 10, 11, 1, 10],
+      [:attribute_quoted_value_start, 11, 12, 1, 11],
+      [:attribute_quoted_value, 12, 15, 1, 12],
+      [:attribute_quoted_value_end, 15, 16, 1, 15],
+      [:whitespace, 16, 17, 1, 16],
+    ], tokens.to_a
+    assert_equal "foo", @parser.attribute_value
+    tokens = @parser.parse_tokens(">")
+    assert_equal [[:tag_end, 17, 18, 2, 0]], tokens.to_a
+    assert_equal 17, tokens.byte_start(0)
+    assert_equal :none, @parser.context
+  end
+
   def test_solidus_or_tag_name_error
     parse('<>')
     assert_equal 1, @parser.errors_count
@@ -544,6 +672,34 @@ class HtmlTokenizer::ParserTest < Minitest::Test
     ], tokens
   end
 
+  def test_line_and_column_numbers_with_mutlibyte_characters
+    tokens = []
+    parse("<div>’\n’’<a>") { |*token| tokens << token }
+    assert_equal [
+      [:tag_start, 0, 1, 1, 0],
+      [:tag_name, 1, 4, 1, 1],
+      [:tag_end, 4, 5, 1, 4],
+      [:text, 5, 9, 1, 5],
+      [:tag_start, 9, 10, 2, 2],
+      [:tag_name, 10, 11, 2, 3],
+      [:tag_end, 11, 12, 2, 4],
+    ], tokens
+    assert_equal 2, @parser.line_number
+    assert_equal 5, @parser.column_number
+    assert_equal 12, @parser.document_length
+  end
+
+  def test_positions_are_contiguous_across_chunks
+    tokens = []
+    parse("<![CDATA[\x81]]>".force_encoding("Shift_JIS"), "x".force_encoding("Shift_JIS")) { |*token| tokens << token }
+    assert_equal [
+      [:cdata_start, 0, 9, 1, 0],
+      [:text, 9, 10, 1, 9],
+      [:cdata_end, 10, 13, 1, 10],
+      [:text, 13, 14, 1, 13],
+    ], tokens
+  end
+
   def test_valid_syntaxes
     parse(
       '<div>',
@@ -583,6 +739,182 @@ class HtmlTokenizer::ParserTest < Minitest::Test
     assert_equal 0, @parser.errors_count, "Expected no errors: #{@parser.errors}"
   end
 
+  def test_many_errors
+    parse("<div =a>" * 1000)
+    assert_equal 2000, @parser.errors_count
+    errors = @parser.errors
+    assert_equal 2000, errors.size
+    assert_equal "expected whitespace, '>', attribute name or value", errors.last.to_s
+    assert_equal [7998, 1, 7998], [errors.last.position, errors.last.line, errors.last.column]
+  end
+
+  def test_parse_file
+    data = "<div class=\"é\">\n<!-- x --></div>" * 100
+    Tempfile.create("parser_test") do |file|
+      file.write(data)
+      file.close
+      tokens = []
+      @parser = HtmlTokenizer::Parser.new
+      @parser.parse_file(file.path) { |*token| tokens << token }
+      expected = []
+      HtmlTokenizer::Parser.new.parse(data) { |*token| expected << token }
+      assert_equal expected, tokens
+      assert_equal data, @parser.document
+      assert_equal Encoding::UTF_8, @parser.document.encoding
+    end
+  end
+
+  def test_parse_file_from_pipe
+    skip "no /dev/fd" unless File.directory?("/dev/fd")
+    data = "<div class=\"foo\">bar</div>" * 10_000
+    IO.pipe do |reader, writer|
+      writer_thread = Thread.new { writer.write(data); writer.close }
+      @parser = HtmlTokenizer::Parser.new
+      @parser.parse_file("/dev/fd/#{reader.fileno}", encoding: "ASCII-8BIT")
+      writer_thread.join
+      assert_equal data, @parser.document
+      assert_equal Encoding::ASCII_8BIT, @parser.document.encoding
+      assert_equal "div", @parser.tag_name
+    end
+  end
+
+  def test_parse_file_errors
+    assert_raises(Errno::ENOENT) { HtmlTokenizer::Parser.new.parse_file("/nonexistent/file.html") }
+    parse("<div>")
+    e = assert_raises(ArgumentError) { @parser.parse_file(__FILE__, encoding: "Shift_JIS") }
+    assert_equal "cannot append Shift_JIS string to UTF-8 document", e.message
+  end
+
+  def test_accessors_return_cached_frozen_strings
+    parse("<div class='foo")
+    name = @parser.attribute_name
+    assert_predicate name, :frozen?
+    assert_same name, @parser.attribute_name
+    assert_same @parser.tag_name, @parser.tag_name
+    value = @parser.attribute_value
+    assert_equal "foo", value
+    parse("bar'>")
+    assert_equal "foobar", @parser.attribute_value
+    assert_equal "foo", value
+    assert_predicate @parser.attribute_value, :frozen?
+  end
+
+  def test_intern_names
+    @parser = HtmlTokenizer::Parser.new(intern_names: true)
+    parse("<div class='foo'>")
+    assert_same "div".dup.freeze.-@, @parser.tag_name
+    assert_same HtmlTokenizer::Parser.new(intern_names: true).tap { |p| p.parse("<x class>") }.attribute_name,
+      @parser.attribute_name
+    refute_same @parser.attribute_value, "foo".-@
+  end
+
+  def test_reset_keeps_buffers
+    @parser = HtmlTokenizer::Parser.new(intern_names: true)
+    parse("<div =a>" * 100)
+    stats = @parser.memory_stats
+    assert_same @parser, @parser.reset
+    assert_nil @parser.document
+    assert_equal 0, @parser.document_length
+    assert_equal 0, @parser.errors_count
+    assert_nil @parser.tag_name
+    assert_equal 1, @parser.line_number
+    assert_equal stats[:document][:capacity], @parser.memory_stats[:document][:capacity]
+    assert_equal stats[:errors][:capacity], @parser.memory_stats[:errors][:capacity]
+    parse("<p class='x'>".b)
+    assert_equal Encoding::ASCII_8BIT, @parser.document.encoding
+    assert_equal "<p class='x'>", @parser.document
+    assert_same "class".b.-@, @parser.attribute_name
+  end
+
+  def test_parse_events
+    data = "a<div class='x y' id=z disabled>é<br/></div><!-- c --><script>if(a<b)</script><![CDATA[d]]>"
+    events = []
+    @parser = HtmlTokenizer::Parser.new
+    @parser.parse_events(data) { |*event| events << event }
+    assert_equal [
+      [:text, 0, 1, "a"],
+      [:start_tag, 1, 32, "div", [[6, 11, 13, 16, true], [18, 20, 21, 22, false], [23, 31, nil, nil, false]], false],
+      [:text, 32, 33, "é"],
+      [:start_tag, 33, 38, "br", [], true],
+      [:end_tag, 38, 44, "div", [], false],
+      [:comment, 44, 54, " c "],
+      [:start_tag, 54, 62, "script", [], false],
+      [:text, 62, 69, "if(a<b)"],
+      [:end_tag, 69, 78, "script", [], false],
+      [:cdata, 78, 91, "d"],
+    ], events
+    assert_equal "class", data[6...11]
+    assert_equal "x y", data[13...16]
+    assert_equal 0, @parser.errors_count
+  end
+
+  def test_parse_events_across_chunks
+    events = []
+    @parser = HtmlTokenizer::Parser.new
+    ["ab", "c<di", "v a", "='1'>", "<!--", "x-->"].each do |chunk|
+      @parser.parse_events(chunk) { |*event| events << event }
+    end
+    @parser.append_placeholder("<%= y %>")
+    @parser.parse_events("z") { |*event| events << event }
+    assert_equal [
+      [:text, 0, 2, "ab"],
+      [:text, 2, 3, "c"],
+      [:start_tag, 3, 14, "div", [[8, 9, 11, 12, true]], false],
+      [:comment, 14, 22, "x"],
+      [:text, 30, 31, "z"],
+    ], events
+  end
+
+  def test_parse_events_requires_block
+    assert_raises(LocalJumpError) { HtmlTokenizer::Parser.new.parse_events("<div>") }
+  end
+
+  def test_parse_only_and_except
+    source = "<div class='x'>\n  a &lt; b \nc</div><!-- é -->"
+    all = []
+    HtmlTokenizer::Parser.new.parse(source) { |*token| all << token }
+
+    only = []
+    @parser = HtmlTokenizer::Parser.new
+    @parser.parse(source, only: [:text, :comment_start]) { |*token| only << token }
+    assert_equal all.select { |name, *| [:text, :comment_start].include?(name) }, only
+    assert_equal " é ", @parser.comment_text
+    assert_equal "div", @parser.tag_name
+    assert_equal true, @parser.closing_tag?
+
+    except = []
+    HtmlTokenizer::Parser.new.parse(source, except: [:whitespace, :tag_end]) { |*token| except << token }
+    assert_equal all.reject { |name, *| [:whitespace, :tag_end].include?(name) }, except
+  end
+
+  def test_memsize_counts_document
+    @parser = HtmlTokenizer::Parser.new
+    empty = ObjectSpace.memsize_of(@parser)
+    parse("<div>" * 10_000)
+    assert_operator ObjectSpace.memsize_of(@parser), :>=, empty + 50_000
+  end
+
+  def test_memory_stats
+    @parser = HtmlTokenizer::Parser.new
+    assert_equal({ capacity: 0, used: 0 }, @parser.memory_stats[:document])
+    parse("<div =a>" * 100)
+    stats = @parser.memory_stats
+    assert_equal 801, stats[:document][:used]
+    assert_operator stats[:document][:capacity], :>=, 801
+    assert_operator stats[:errors][:capacity], :>=, stats[:errors][:used]
+    assert_operator stats[:errors][:used], :>, 0
+    assert_operator ObjectSpace.memsize_of(@parser), :>=, stats[:total]
+    assert_equal({ capacity: 0, used: 0 }, stats[:attributes])
+    assert_equal stats[:total], stats[:struct] +
+      stats.values_at(:document, :errors, :attributes, :lines).sum { |buffer| buffer[:capacity] }
+    @parser.parse_events("<div a=1 b=2 c=3>") {}
+    stats = @parser.memory_stats
+    assert_operator stats[:attributes][:capacity], :>, 0
+    assert_operator stats[:attributes][:capacity], :>=, stats[:attributes][:used]
+    assert_equal stats[:total], stats[:struct] +
+      stats.values_at(:document, :errors, :attributes, :lines).sum { |buffer| buffer[:capacity] }
+  end
+
   private
 
   def parse(*parts, &block)
@@ -0,0 +1,86 @@
+require "minitest/autorun"
+require "html_tokenizer"
+
+class HtmlTokenizer::PoolTest < Minitest::Test
+  def test_with_parser_reuses_a_reset_parser
+    first = HtmlTokenizer::Pool.with_parser do |parser|
+      parser.parse("<div class='foo'>")
+      parser
+    end
+    HtmlTokenizer::Pool.with_parser do |parser|
+      assert_same first, parser
+      assert_nil parser.document
+      assert_nil parser.tag_name
+      parser.parse("<p>")
+      assert_equal "p", parser.tag_name
+    end
+  end
+
+  def test_nested_use_takes_separate_objects
+    HtmlTokenizer::Pool.with_parser do |outer|
+      HtmlTokenizer::Pool.with_parser do |inner|
+        refute_same outer, inner
+      end
+    end
+  end
+
+  def test_options_are_pooled_separately
+    HtmlTokenizer::Pool.with_parser(intern_names: true) do |parser|
+      parser.parse("<div>")
+      assert_same "div".-@, parser.tag_name
+    end
+    HtmlTokenizer::Pool.with_parser do |parser|
+      parser.parse("<div>")
+      refute_same "div".-@, parser.tag_name
+    end
+  end
+
+  def test_parser_is_returned_when_block_raises
+    parser = nil
+    assert_raises(RuntimeError) do
+      HtmlTokenizer::Pool.with_parser do |p|
+        parser = p
+        p.parse("<div>") { raise "boom" }
+      end
+    end
+    HtmlTokenizer::Pool.with_parser do |p|
+      assert_same parser, p
+      p.parse("<a>")
+      assert_equal "<a>", p.document
+    end
+  end
+
+  def test_large_documents_are_not_retained
+    large = HtmlTokenizer::Pool.with_parser do |parser|
+      parser.parse("x" * (HtmlTokenizer::Pool::MAX_RETAINED_BYTES + 1))
+      parser
+    end
+    HtmlTokenizer::Pool.with_parser do |parser|
+      refute_same large, parser
+    end
+  end
+
+  def test_parsers_with_large_line_index_are_not_retained
+    large = HtmlTokenizer::Pool.with_parser do |parser|
+      parser.parse("\n" * 200_000)
+      assert_operator parser.document_bytesize, :<, HtmlTokenizer::Pool::MAX_RETAINED_BYTES
+      parser.document_line_count
+      assert_operator parser.memory_stats[:total], :>, HtmlTokenizer::Pool::MAX_RETAINED_BYTES
+      parser
+    end
+    HtmlTokenizer::Pool.with_parser do |parser|
+      refute_same large, parser
+    end
+  end
+
+  def test_with_tokenizer
+    tokens = []
+    HtmlTokenizer::Pool.with_tokenizer do |tokenizer|
+      tokenizer.feed("<div") {}
+    end
+    HtmlTokenizer::Pool.with_tokenizer do |tokenizer|
+      tokenizer.tokenize("<p>") { |*token| tokens << token }
+    end
+    assert_equal [[:tag_start, 0, 1], [:tag_name, 1, 2], [:tag_end, 2, 3]], tokens
+  end
+end
@@ -1,5 +1,6 @@
 require "minitest/autorun"
 require "html_tokenizer"
+require "tempfile"
 
 class HtmlTokenizer::TokenizerTest < Minitest::Test
   def test_closing_tag_without_start_is_text
@@ -260,6 +261,23 @@ class HtmlTokenizer::TokenizerTest < Minitest::Test
     ], result
   end
 
+  def test_tokenize_rawtext_tag_name_case_and_chunks
+    result = tokenize('<SCR', 'ipt>foo <b></sCrIpT>')
+    assert_equal [
+      [:tag_start, "<"], [:tag_name, "SCR"], [:tag_name, "ipt"], [:tag_end, ">"],
+      [:text, "foo "], [:text, "<b"], [:text, ">"],
+      [:tag_start, "<"], [:solidus, "/"], [:tag_name, "sCrIpT"], [:tag_end, ">"],
+    ], result
+  end
+
+  def test_tokenize_long_tag_name_starting_with_rawtext_name
+    result = tokenize('<scriptscriptscriptscript><b>')
+    assert_equal [
+      [:tag_start, "<"], [:tag_name, "scriptscriptscriptscript"], [:tag_end, ">"],
+      [:tag_start, "<"], [:tag_name, "b"], [:tag_end, ">"],
+    ], result
+  end
+
   def test_tokenize_script_containing_html
     result = tokenize('<script type="text/html">foo <b> bar</script>')
     assert_equal [
@@ -324,6 +342,37 @@ class HtmlTokenizer::TokenizerTest < Minitest::Test
     ], result
   end
 
+  def test_tokenize_long_runs_of_each_character_class
+    name = "data-" + ("a_B.c:1-" * 9)
+    space = " \t\r\n" * 17
+    value = "/path/to/" + ("x" * 70)
+    result = tokenize("<#{name}#{space}#{name}=#{value}#{space}>")
+    assert_equal [
+      [:tag_start, "<"], [:tag_name, name], [:whitespace, space],
+      [:attribute_name, name], [:equal, "="], [:attribute_unquoted_value, value],
+      [:whitespace, space], [:tag_end, ">"]
+    ], result
+  end
+
+  def test_tokenize_long_comment_with_partial_end_markers
+    text = " <a href='x'>-</a> -- -> ->- " * 10
+    result = tokenize("<!--#{text}-->")
+    assert_equal [[:comment_start, "<!--"], [:text, text], [:comment_end, "-->"]], result
+  end
+
+  def test_tokenize_long_cdata_with_partial_end_markers
+    text = " a[b[0]] ]> ]]] " * 10
+    result = tokenize("<![CDATA[#{text}]]>")
+    assert_equal [[:cdata_start, "<![CDATA["], [:text, text], [:cdata_end, "]]>"]], result
+  end
+
+  def test_tokenize_comment_end_split_across_chunks
+    result = tokenize("<!-- foo --", "> bar")
+    assert_equal [
+      [:comment_start, "<!--"], [:text, " foo --"], [:text, "> bar"]
+    ], result
+  end
+
   def test_html_with_mutlibyte_characters
     data = "<div title='your store’s'>foo</div>"
     result = tokenize(data)
@@ -345,8 +394,293 @@ class HtmlTokenizer::TokenizerTest < Minitest::Test
     ], result
   end
 
+  def test_tokenize_to_buffer
+    data = "<div title='your store’s'>\nfoo</div>"
+    tokens = HtmlTokenizer::Tokenizer.new.tokenize_to_buffer(data)
+    assert_equal 14, tokens.size
+    assert_equal [:tag_start, 0, 1, 1, 0], tokens[0]
+    assert_equal [:attribute_quoted_value, 12, 24, 1, 12], tokens[6]
+    assert_equal [:text, 26, 30, 1, 26], tokens[9]
+    assert_equal [:tag_start, 30, 31, 2, 3], tokens[10]
+    assert_equal :tag_end, tokens.type(-1)
+    assert_equal "your store’s", data.byteslice(tokens.byte_start(6)...tokens.byte_end(6))
+    assert_nil tokens[14]
+    assert_equal tokenize(data), tokens.map { |name, start, stop| [name, data[start...stop]] }
+  end
+
+  def test_tokenize_to_buffer_large_input_from_threads
+    data = "<div class='foo'>\n<p>bar &amp; baz</p><!-- x --></div>\n" * 2000
+    expected = tokenize(data)
+    threads = 4.times.map do
+      Thread.new { HtmlTokenizer::Tokenizer.new.tokenize_to_buffer(data) }
+    end
+    threads.each do |thread|
+      tokens = thread.value
+      assert_equal expected, tokens.map { |name, start, stop| [name, data[start...stop]] }
+      assert_equal [:text, data.length - 1, data.length, 4000, 36], tokens[-1]
+    end
+  end
+
+  def test_tokenize_to_buffer_interrupted_leaves_tokenizer_usable
+    tokenizer = HtmlTokenizer::Tokenizer.new
+    error = assert_raises(RuntimeError) { interrupt_tokenize_to_buffer(tokenizer, "<a>" * 22_000) }
+    assert_equal "interrupted", error.message
+    assert_equal "tokenize_to_buffer", error.backtrace_locations.first.label
+    tokens = []
+    tokenizer.tokenize("<p>") { |name, start, stop| tokens << [name, start, stop] }
+    assert_equal [[:tag_start, 0, 1], [:tag_name, 1, 2], [:tag_end, 2, 3]], tokens
+    assert_equal 3, tokenizer.tokenize_to_buffer("<p>").size
+  end
+
+  def test_tokenize_to_buffer_with_threads_interrupted_waits_for_workers
+    tokenizer = HtmlTokenizer::Tokenizer.new
+    threads = Thread.list
+    error = assert_raises(RuntimeError) do
+      interrupt_tokenize_to_buffer(tokenizer, "<a>" * 180_000, threads: 4)
+    end
+    assert_equal [], Thread.list - threads
+    assert_equal "interrupted", error.message
+    assert_equal "tokenize_to_buffer", error.backtrace_locations.first.label
+    assert_equal 3, tokenizer.tokenize_to_buffer("<p>", threads: 4).size
+  end
+
+  def test_tokenize_to_buffer_with_threads_matches_sequential_scan
+    page = "<div class='foo'>\n<p>bar &amp; baz</p></div>\n" * 3000
+    data = page + "<!-- " + page + " --><script>" + page + "</script>" + page
+    sequential = HtmlTokenizer::Tokenizer.new
+    parallel = HtmlTokenizer::Tokenizer.new
+    [1, 2, 4, 8].each do |threads|
+      expected = sequential.tokenize_to_buffer(data).to_a
+      assert_equal expected, parallel.tokenize_to_buffer(data, threads: threads).to_a
+    end
+    assert_equal sequential.tokenize_to_buffer("<p>").to_a, parallel.tokenize_to_buffer("<p>").to_a
+  end
+
+  def test_token_types_constant
+    assert_predicate HtmlTokenizer::TOKEN_TYPES, :frozen?
+    assert_equal :none, HtmlTokenizer::TOKEN_TYPES[0]
+    assert_equal :malformed, HtmlTokenizer::TOKEN_TYPES.last
+    tokens = HtmlTokenizer::Tokenizer.new.tokenize_to_buffer("<div>")
+    assert_equal [:tag_start, :tag_name, :tag_end],
+      tokens.size.times.map { |i| HtmlTokenizer::TOKEN_TYPES[tokens.type_id(i)] }
+  end
+
+  def test_feed_matches_tokenize_at_every_split
+    data = "<!DOCTYPE html><div title='a \"b\"'><!-- c -- d --><![CDATA[e]]>" \
+      "<script>if(a</b) {}</script>é<title>x</titlex></title>"
+    expected = []
+    HtmlTokenizer::Tokenizer.new.tokenize(data) { |*token| expected << token }
+    (0..data.bytesize).each do |split|
+      tokens = []
+      tokenizer = HtmlTokenizer::Tokenizer.new
+      tokenizer.feed(data.byteslice(0, split)) { |*token| tokens << token }
+      tokenizer.feed(data.byteslice(split..-1)) { |*token| tokens << token }
+      tokenizer.finish { |*token| tokens << token }
+      assert_equal expected, tokens, "split at byte #{split}"
+    end
+  end
+
+  def test_feed_holds_the_cut_token
+    tokens = []
+    tokenizer = HtmlTokenizer::Tokenizer.new
+    tokenizer.feed("<script>foo</scr") { |*token| tokens << token }
+    assert_equal [[:tag_start, 0, 1], [:tag_name, 1, 7], [:tag_end, 7, 8], [:text, 8, 11]], tokens
+    tokenizer.feed("ipt>bar") { |*token| tokens << token }
+    tokenizer.finish { |*token| tokens << token }
+    assert_equal [
+      [:tag_start, 11, 12], [:solidus, 12, 13], [:tag_name, 13, 19], [:tag_end, 19, 20], [:text, 20, 23],
+    ], tokens[4..-1]
+  end
+
+  def test_feed_splits_long_runs_at_character_boundaries
+    data = "é" * 100_000
+    tokens = []
+    tokenizer = HtmlTokenizer::Tokenizer.new
+    data.b.chars.each_slice(4099) { |chunk| tokenizer.feed(chunk.join.force_encoding("UTF-8")) { |*token| tokens << token } }
+    tokenizer.finish { |*token| tokens << token }
+    assert_operator tokens.size, :>, 1
+    assert_equal [0, data.length], [tokens.first[1], tokens.last[2]]
+    tokens.each_cons(2) { |a, b| assert_equal a[2], b[1] }
+    assert_equal data, tokens.map { |_, start, stop| data[start...stop] }.join
+  end
+
+  def test_feed_rejects_mixed_encodings
+    tokenizer = HtmlTokenizer::Tokenizer.new
+    tokenizer.feed("<p>") {}
+    e = assert_raises(ArgumentError) { tokenizer.feed("é".encode("ISO-8859-1")) {} }
+    assert_equal "cannot append ISO-8859-1 string to UTF-8 stream", e.message
+  end
+
+  def test_tokenize_io
+    require "stringio"
+    data = "<div class=\"foo\">\nbär</div>\n" * 1000
+    expected = []
+    HtmlTokenizer::Tokenizer.new.tokenize(data) { |*token| expected << token }
+    tokens = []
+    HtmlTokenizer::Tokenizer.new.tokenize_io(StringIO.new(data.b), chunk_size: 1000) { |*token| tokens << token }
+    assert_equal expected, tokens
+  end
+
+  def test_tokenize_file
+    data = "<div class='foo'>\n<script>a</b</script>日本</div>" * 1000
+    Tempfile.create("tokenizer_test") do |file|
+      file.write(data)
+      file.close
+      expected = []
+      HtmlTokenizer::Tokenizer.new.tokenize(data) { |*token| expected << token }
+      tokens = []
+      HtmlTokenizer::Tokenizer.new.tokenize_file(file.path) { |*token| tokens << token }
+      assert_equal expected, tokens
+    end
+  end
+
+  def test_tokenize_file_from_pipe
+    skip "no /dev/fd" unless File.directory?("/dev/fd")
+    data = "<div class='foo'>\n<!-- bar -->é</div>" * 10_000
+    expected = []
+    HtmlTokenizer::Tokenizer.new.tokenize(data) { |*token| expected << token }
+    IO.pipe do |reader, writer|
+      writer_thread = Thread.new { writer.write(data); writer.close }
+      tokens = []
+      HtmlTokenizer::Tokenizer.new.tokenize_file("/dev/fd/#{reader.fileno}") { |*token| tokens << token }
+      writer_thread.join
+      assert_equal expected, tokens
+    end
+  end
+
+  def test_tokenize_file_errors
+    assert_raises(Errno::ENOENT) { HtmlTokenizer::Tokenizer.new.tokenize_file("/nonexistent/file.html") {} }
+    assert_raises(ArgumentError) { HtmlTokenizer::Tokenizer.new.tokenize_file(__FILE__, encoding: "nope") {} }
+  end
+
+  def test_reset_drops_stream
+    tokenizer = HtmlTokenizer::Tokenizer.new
+    tokenizer.feed("<div class='foo") {}
+    assert_same tokenizer, tokenizer.reset
+    tokens = []
+    tokenizer.feed("bar") { |*token| tokens << token }
+    tokenizer.finish { |*token| tokens << token }
+    assert_equal [[:text, 0, 3]], tokens
+  end
+
+  def test_tokenize_deeply_nested_tag_starts
+    data = "<div <p <!DOCTYPE <a b='<c' d=<e " * 1000
+    tokens = tokenize(data)
+    refute_includes tokens.map(&:first), :malformed
+    assert_equal data, tokens.map(&:last).join
+  end
+
+  def test_tokenize_only_and_except
+    source = "<div class='é'>\n  <script>if(a<b)</script>ünï <br/>x</div>"
+    all = []
+    HtmlTokenizer::Tokenizer.new.tokenize(source) { |*token| all << token }
+
+    only = []
+    HtmlTokenizer::Tokenizer.new.tokenize(source, only: [:text, :attribute_quoted_value]) { |*token| only << token }
+    assert_equal all.select { |name, _, _| [:text, :attribute_quoted_value].include?(name) }, only
+
+    except = []
+    HtmlTokenizer::Tokenizer.new.tokenize(source, except: :whitespace) { |*token| except << token }
+    assert_equal all.reject { |name, _, _| name == :whitespace }, except
+  end
+
+  def test_each_token
+    data = "<div class='foo'>\n<script>a</b</script>日本</div>" * 100
+    expected = []
+    HtmlTokenizer::Tokenizer.new.tokenize(data) { |*token| expected << token }
+
+    tokens = HtmlTokenizer::Tokenizer.new.each_token(data)
+    assert_equal [:tag_start, 0, 1], tokens.peek
+    assert_equal [:tag_start, 0, 1], tokens.next
+    assert_equal [:tag_name, 1, 4], tokens.next
+    assert_equal expected.drop(2), tokens.to_a
+    assert_raises(StopIteration) { tokens.next }
+    assert_raises(StopIteration) { tokens.peek }
+  end
+
+  def test_each_token_starts_from_tokenizer_context
+    tokenizer = HtmlTokenizer::Tokenizer.new
+    tokenizer.tokenize("<script>") {}
+    source = +"a<b>c</script>d"
+    tokens = tokenizer.each_token(source, only: [:text, :tag_name])
+    source.replace("xxxxxxxxxxxxxxx")
+    assert_equal [[:text, 0, 1], [:text, 1, 3], [:text, 3, 5], [:tag_name, 7, 13], [:text, 14, 15]], tokens.to_a
+    assert_equal :text, tokenizer.tokenize_to_buffer("<b>").type(0)
+  end
+
+  def test_tokenize_stop
+    tokenizer = HtmlTokenizer::Tokenizer.new
+    names = []
+    result = tokenizer.tokenize("é\n<!DOCTYPE html><script>") do |name, _, _|
+      names << name
+      :stop if name == :tag_name
+    end
+    assert_equal [:text, :tag_start, :tag_name], names
+    assert_equal HtmlTokenizer::StopPosition.new(12, 11, 2, 9), result
+
+    tokens = []
+    assert_equal true, tokenizer.tokenize("<a>") { |*token| tokens << token }
+    assert_equal [[:tag_start, 0, 1], [:tag_name, 1, 2], [:tag_end, 2, 3]], tokens
+
+    result = tokenizer.tokenize("<a><b>") { |name, _, _| tokenizer.stop! if name == :tag_end }
+    assert_equal 3, result.char_offset
+  end
+
+  def test_feed_stop
+    tokenizer = HtmlTokenizer::Tokenizer.new
+    assert_equal true, tokenizer.feed("<div>ab") {}
+    result = tokenizer.feed("c<di") { |name, _, _| :stop if name == :text }
+    assert_equal HtmlTokenizer::StopPosition.new(8, 8, 1, 8), result
+
+    tokens = []
+    tokenizer.feed("v>") { |*token| tokens << token }
+    assert_equal true, tokenizer.finish { |*token| tokens << token }
+    assert_equal [[:text, 0, 2]], tokens
+  end
+
+  def test_tokenize_file_and_io_stop
+    require "stringio"
+    data = "<title>x</title>" + "<p>y</p>" * 100_000
+    Tempfile.create("tokenizer_test") do |file|
+      file.write(data)
+      file.close
+      tokens = 0
+      result = HtmlTokenizer::Tokenizer.new.tokenize_file(file.path) { |name, _, _| tokens += 1; :stop if name == :text }
+      assert_equal 4, tokens
+      assert_equal 8, result.byte_offset
+    end
+    if File.directory?("/dev/fd")
+      IO.pipe do |reader, writer|
+        writer.write(data[0, 40_000])
+        writer.close
+        result = HtmlTokenizer::Tokenizer.new.tokenize_file("/dev/fd/#{reader.fileno}") { |name, _, _| :stop if name == :text }
+        assert_equal 8, result.byte_offset
+      end
+    end
+    io = StringIO.new(data)
+    result = HtmlTokenizer::Tokenizer.new.tokenize_io(io, chunk_size: 100) { |name, _, _| :stop if name == :text }
+    assert_equal 8, result.byte_offset
+    assert_equal 100, io.pos
+  end
+
+  def test_tokenize_token_mask_errors
+    tokenizer = HtmlTokenizer::Tokenizer.new
+    assert_raises(ArgumentError) { tokenizer.tokenize("<div>", only: [:tag]) {} }
+    assert_raises(ArgumentError) { tokenizer.tokenize("<div>", only: [:text], except: [:tag_name]) {} }
+    assert_equal [[:tag_name, "div"]], tokenize("<div>").select { |name, _| name == :tag_name }
+  end
+
   private
 
+  # Queues an interrupt that is only delivered at a blocking region, so
+  # it lands as tokenize_to_buffer takes the GVL back after its scan.
+  def interrupt_tokenize_to_buffer(tokenizer, data, **options)
+    Thread.handle_interrupt(RuntimeError => :on_blocking) do
+      Thread.current.raise(RuntimeError, "interrupted")
+      tokenizer.tokenize_to_buffer(data, **options)
+    end
+  end
+
   def tokenize(*parts)
     tokens = []
     @tokenizer = HtmlTokenizer::Tokenizer.new